@@ -27,6 +27,36 @@ glm::mat4x4 Camera::GetInverseProjectionView()
 	return _inverse_projection_view;
 }
 
+glm::mat4x4 Camera::GetView()
+{
+	return _view;
+}
+
+void Camera::SetView( glm::mat4x4 view )
+{
+	// same convention as Update(), so the next Update() doesn't see this as movement.
+	_view                       = view;
+	_projection_view            = _projection * _view;
+	_inverse_projection_view    = glm::inverse( _projection_view );
+}
+
+void Camera::SetResolution( glm::vec2 resolution )
+{
+	_projection                 = glm::perspective( 45.0f, resolution.x / resolution.y, 0.02f, 300.0f );
+	_projection_view            = _projection * _view;
+	_inverse_projection_view    = glm::inverse( _projection_view );
+}
+
+// sub-viewport of the full image, maps the tile's own [-1, 1] range onto its part of the image.
+glm::mat4x4 Camera::GetTileInverseProjectionView( glm::vec2 offset, glm::vec2 size, glm::vec2 resolution )
+{
+	glm::vec2 scale             = size / resolution;
+	glm::vec2 center            = ( offset * 2.0f + size ) / resolution - 1.0f;
+
+	glm::mat4x4 tile            = glm::translate( glm::mat4x4(1.0f), glm::vec3(center, 0.0f) ) * glm::scale( glm::mat4x4(1.0f), glm::vec3(scale, 1.0f) );
+	return _inverse_projection_view * tile;
+}
+
 bool Camera::Update()
 {
 	const float speed = 0.05f;
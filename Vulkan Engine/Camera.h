@@ -37,5 +37,11 @@ class Camera
 
 		glm::mat4x4             GetProjectionView();
 		glm::mat4x4             GetInverseProjectionView();
+
+		glm::mat4x4             GetView();
+		void                    SetView( glm::mat4x4 view );
+
+		void                    SetResolution( glm::vec2 resolution );
+		glm::mat4x4             GetTileInverseProjectionView( glm::vec2 offset, glm::vec2 size, glm::vec2 resolution );
 };
 
@@ -23,8 +23,22 @@ Presentation::Presentation(Renderer * renderer, VkSurfaceKHR surface, VkSurfaceC
 	_CreatePresentationSampler();
 }
 
+// the renderer waited for the device, nothing presented is in flight.
 Presentation::~Presentation()
 {
+	VkDevice device = _renderer->GetDevice();
+
+	// destroying the pools frees their command buffers.
+	vkDestroyCommandPool(device, _present_queue_command_pool, nullptr);
+	vkDestroyCommandPool(device, _blit_command_pool, nullptr);
+
+	for (uint32_t i = 0; i < (uint32_t)_semaphores_image_available.size(); i++)
+	{
+		vkDestroySemaphore(device, _semaphores_image_available[i], nullptr);
+		vkDestroySemaphore(device, _semaphores_rendering_finished[i], nullptr);
+	}
+	vkDestroySampler(device, _sampler, nullptr);
+
 	_DeInitSwapChainImages();
 	_DeInitSwapChain();
 }
@@ -35,13 +49,24 @@ uint32_t Presentation::PreviousFrame()
 	return _previous_image;
 }
 
-uint32_t Presentation::PrepareFrame()
+// false when no image was acquired, the frame has to be skipped. an out of date swapchain is recreated right away.
+bool Presentation::PrepareFrame(uint32_t & image_index)
 {
+	VkResult result = vkAcquireNextImageKHR(_renderer->GetDevice(), _swapchain, UINT64_MAX, _semaphores_image_available[_frame_index], VK_NULL_HANDLE, &image_index);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		_recreated = Resize(_surface_size_x, _surface_size_y) || _recreated;
+		return false;
+	}
+
+	// suboptimal still signals the semaphore, the swapchain is recreated after presenting.
+	ErrorCheck(result, "Unable to acquire a swapchain image.");
+	if (result < 0)
+		return false;
+
 	_previous_image = _current_image;
-	uint32_t image_index;
-	ErrorCheck(vkAcquireNextImageKHR(_renderer->GetDevice(), _swapchain, UINT64_MAX, _semaphore_image_available, VK_NULL_HANDLE, &image_index), "Swapchain image aquisition successfull.");
 	_current_image = image_index;
-	return image_index;
+	return true;
 }
 
 void Presentation::RenderFrame(uint32_t image_index)
@@ -52,18 +77,31 @@ void Presentation::RenderFrame(uint32_t image_index)
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	present_info.pNext = nullptr;
 	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = &_semaphore_rendering_finished;
+	present_info.pWaitSemaphores = &_semaphores_rendering_finished[_frame_index];
 	present_info.swapchainCount = 1;
 	present_info.pSwapchains = &_swapchain;
 	present_info.pImageIndices = &image_index;
 	present_info.pResults = nullptr;
 
-	ErrorCheck(vkQueuePresentKHR(_renderer->GetQueue(), &present_info), "Unable to present an image to the screen." "Image presentation was successfull");
+	VkResult result = vkQueuePresentKHR(_renderer->GetQueue(), &present_info);
+
+	// next frame uses the next set of semaphores.
+	_frame_index = (_frame_index + 1) % BUILD_FRAMES_IN_FLIGHT;
+
+	// the surface changed before the window told us, presented or not the semaphores were consumed.
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	{
+		_recreated = Resize(_surface_size_x, _surface_size_y) || _recreated;
+		return;
+	}
+	ErrorCheck(result, "Unable to present an image to the screen.");
 }
 
 void Presentation::Clear()
 {
-	uint32_t image_index = PrepareFrame();
+	uint32_t image_index = 0;
+	if (!PrepareFrame(image_index))
+		return;
 
 	// submit queue.
 	VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
@@ -71,29 +109,105 @@ void Presentation::Clear()
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.pNext = nullptr;
 	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = &_semaphore_image_available;
+	submit_info.pWaitSemaphores = &_semaphores_image_available[_frame_index];
 	submit_info.pWaitDstStageMask = &wait_dst_stage_mask;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &_present_queue_command_buffers[image_index];
 	submit_info.signalSemaphoreCount = 1,
-	submit_info.pSignalSemaphores = &_semaphore_rendering_finished;
+	submit_info.pSignalSemaphores = &_semaphores_rendering_finished[_frame_index];
 
 	ErrorCheck(vkQueueSubmit(_renderer->GetQueue(), 1, &submit_info, VK_NULL_HANDLE), "Unable to submit the queue.", "Submitting the queue was successfull");
 
 	RenderFrame(image_index);
+
+	// no fence guards this frame, its semaphores have to be free before they come around again.
+	vkQueueWaitIdle(_renderer->GetQueue());
 }
 
 
 
-VkDescriptorImageInfo Presentation::GetPresentationImageDescriptor(uint32_t image_index)
+// blits a finished image on the graphics queue, tracing the next frame does not wait for the swapchain.
+void Presentation::Present(VkImage image, VkExtent2D extent, VkSemaphore image_ready, VkFence fence)
 {
-	VkDescriptorImageInfo image_info_descriptor = {};
+	// nothing to blit into, the traced image is still waited on so its semaphore and the frame fence do not hang.
+	uint32_t image_index = 0;
+	if (!PrepareFrame(image_index))
+	{
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.waitSemaphoreCount = 1;
+		submit_info.pWaitSemaphores = &image_ready;
+		submit_info.pWaitDstStageMask = &wait_stage;
+
+		ErrorCheck(vkQueueSubmit(_renderer->GetQueue(), 1, &submit_info, fence), "Unable to submit the skipped frame.");
+		return;
+	}
+
+	VkCommandBuffer command_buffer = _blit_command_buffers[_frame_index];
+	_RecordBlit(command_buffer, image, extent, image_index);
 
-	image_info_descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	image_info_descriptor.imageView = _swapchain_image_views[image_index];
-	image_info_descriptor.sampler = _sampler;
+	// the swapchain image and the traced image are both needed by the blit.
+	VkSemaphore				wait_semaphores[]	= { _semaphores_image_available[_frame_index], image_ready };
+	VkPipelineStageFlags	wait_stages[]		= { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
 
-	return image_info_descriptor;
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = nullptr;
+	submit_info.waitSemaphoreCount = 2;
+	submit_info.pWaitSemaphores = wait_semaphores;
+	submit_info.pWaitDstStageMask = wait_stages;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &_semaphores_rendering_finished[_frame_index];
+
+	ErrorCheck(vkQueueSubmit(_renderer->GetQueue(), 1, &submit_info, fence), "Unable to submit the blit.");
+
+	RenderFrame(image_index);
+}
+
+// new swapchain for a resized window, the old one is handed over so the driver can reuse its resources.
+bool Presentation::Resize(uint32_t surface_x, uint32_t surface_y)
+{
+	vkDeviceWaitIdle(_renderer->GetDevice());
+
+	// the surface decides the extent when it knows it.
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_renderer->GetGPU(), _surface, &_surface_capabilities);
+	if (_surface_capabilities.currentExtent.width < UINT32_MAX) {
+		surface_x = _surface_capabilities.currentExtent.width;
+		surface_y = _surface_capabilities.currentExtent.height;
+	}
+
+	if (surface_x == 0 || surface_y == 0)
+		return false;
+
+	_surface_size_x = surface_x;
+	_surface_size_y = surface_y;
+
+	VkSwapchainKHR old_swapchain = _swapchain;
+	_DeInitSwapChainImages();
+	_InitSwapChain(old_swapchain);
+	vkDestroySwapchainKHR(_renderer->GetDevice(), old_swapchain, nullptr);
+	_InitSwapChainImages();
+
+	// clear commands were recorded for the old images.
+	vkFreeCommandBuffers(_renderer->GetDevice(), _present_queue_command_pool, (uint32_t)_present_queue_command_buffers.size(), _present_queue_command_buffers.data());
+	_AllocateCommandBuffers();
+
+	std::cout << "Swapchain resized to " << _surface_size_x << "x" << _surface_size_y << std::endl;
+	return true;
+}
+
+
+
+// true once after the swapchain recreated itself, the extent may have changed.
+bool Presentation::WasRecreated()
+{
+	bool recreated = _recreated;
+	_recreated = false;
+	return recreated;
 }
 
 VkSampler Presentation::GetPresentationSampler()
@@ -106,6 +220,12 @@ std::vector<VkImage> Presentation::GetSwapchainImages()
 	return _swapchain_images;
 }
 
+// surface may not match the requested window size, everything rendered to it should use this.
+VkExtent2D Presentation::GetExtent()
+{
+	return { _surface_size_x, _surface_size_y };
+}
+
 std::vector<VkImageView> Presentation::GetSwapchainImageViews()
 {
 	return _swapchain_image_views;
@@ -113,17 +233,23 @@ std::vector<VkImageView> Presentation::GetSwapchainImageViews()
 
 VkSemaphore & Presentation::GetSemaphoreRenderingFinished()
 {
-	return _semaphore_rendering_finished;
+	return _semaphores_rendering_finished[_frame_index];
 }
 
 VkSemaphore & Presentation::GetSemaphoreImageAvailable()
 {
-	return _semaphore_image_available;
+	return _semaphores_image_available[_frame_index];
+}
+
+// frame in flight the next PrepareFrame() and RenderFrame() belong to.
+uint32_t Presentation::GetFrameIndex()
+{
+	return _frame_index;
 }
 
 
 
-void Presentation::_InitSwapChain()
+void Presentation::_InitSwapChain(VkSwapchainKHR old_swapchain)
 {
 	// prevent too much.
 	if (_swapchain_image_count > _surface_capabilities.maxImageCount) _swapchain_image_count = _surface_capabilities.maxImageCount;
@@ -158,8 +284,7 @@ void Presentation::_InitSwapChain()
 	swapchain_create_info.imageExtent.height = _surface_size_y;
 	swapchain_create_info.imageArrayLayers = 1;										// 1 = regular, 2 = stereoscopic rendering, can set more for three eyed people n more.
 	swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-		VK_IMAGE_USAGE_SAMPLED_BIT |
-		VK_IMAGE_USAGE_STORAGE_BIT;		// what we gonna do with the image, in our case we want to render to it.
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT;	// what we gonna do with the image, in our case we blit the traced image into it.
 
 	swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;				// we dont want to share them between queue families, but if we want we can reusse them per multiple gpus
 	swapchain_create_info.queueFamilyIndexCount = 0;
@@ -168,7 +293,7 @@ void Presentation::_InitSwapChain()
 	swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;		// can be used to display double windows on top of each other in certain OS
 	swapchain_create_info.presentMode = present_mode;								// vsync option
 	swapchain_create_info.clipped = true;										// dont render whats invisibile, might save battery life & proccessing power. pretty much leave enabled.
-	swapchain_create_info.oldSwapchain = nullptr;									// useful when resizing window
+	swapchain_create_info.oldSwapchain = old_swapchain;								// useful when resizing window
 
 	ErrorCheck(vkCreateSwapchainKHR(_renderer->GetDevice(), &swapchain_create_info, nullptr, &_swapchain), "Unable to create a presentation surface", "Presentation surface has been created.");
 
@@ -207,6 +332,10 @@ void Presentation::_InitSwapChainImages()
 
 		vkCreateImageView(_renderer->GetDevice(), &create_info, nullptr, &_swapchain_image_views[i]);
 	}
+
+	// the images are not ours to allocate, counted at 4 bytes a pixel in device local memory.
+	_swapchain_memory = (VkDeviceSize)_swapchain_image_count * _surface_size_x * _surface_size_y * 4;
+	_renderer->GetAllocator()->Track(MemoryAllocator::SWAPCHAIN, _renderer->GetGPUMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), _swapchain_memory);
 }
 
 void Presentation::_DeInitSwapChainImages()
@@ -215,20 +344,38 @@ void Presentation::_DeInitSwapChainImages()
 	{
 		vkDestroyImageView(_renderer->GetDevice(), _swapchain_image_views[i], nullptr);
 	}
+
+	_renderer->GetAllocator()->Untrack(MemoryAllocator::SWAPCHAIN, _renderer->GetGPUMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), _swapchain_memory);
+	_swapchain_memory = 0;
 }
 
 
 void Presentation::_CreateSemaphores()
 {
-	ErrorCheck( vkCreateSemaphore(_renderer->GetDevice(), &Structs::SemaphoreCreateInfo(), nullptr, &_semaphore_image_available ),
-		"Unable to create a semaphore.", "Semaphore image available successfully created.");
+	_semaphores_image_available.resize(BUILD_FRAMES_IN_FLIGHT);
+	_semaphores_rendering_finished.resize(BUILD_FRAMES_IN_FLIGHT);
 
-	ErrorCheck( vkCreateSemaphore(_renderer->GetDevice(), &Structs::SemaphoreCreateInfo(), nullptr, &_semaphore_rendering_finished ),
-		"Unable to create a semaphore.", "Semaphore finished succesfully created.");
+	for (uint32_t i = 0; i < BUILD_FRAMES_IN_FLIGHT; i++)
+	{
+		ErrorCheck( vkCreateSemaphore(_renderer->GetDevice(), &Structs::SemaphoreCreateInfo(), nullptr, &_semaphores_image_available[i] ),
+			"Unable to create a semaphore.", "Semaphore image available successfully created.");
+
+		ErrorCheck( vkCreateSemaphore(_renderer->GetDevice(), &Structs::SemaphoreCreateInfo(), nullptr, &_semaphores_rendering_finished[i] ),
+			"Unable to create a semaphore.", "Semaphore finished succesfully created.");
+	}
 }
 
 void Presentation::_CreateCommandPoolAndBuffers()
 {
+	// blits are recorded every frame, so they have to be resettable.
+	VkCommandPoolCreateInfo blit_pool_create_info = Structs::CommandPoolCreateInfo(_renderer->GetGraphicsFamilyIndex());
+	blit_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	ErrorCheck(vkCreateCommandPool(_renderer->GetDevice(), &blit_pool_create_info, nullptr, &_blit_command_pool), "Unable to create a blit command pool.", "Blit command pool successfully created.");
+
+	_blit_command_buffers.resize(BUILD_FRAMES_IN_FLIGHT);
+	VkCommandBufferAllocateInfo blit_allocate_info = Structs::CommandBufferAllocateInfo(_blit_command_pool, BUILD_FRAMES_IN_FLIGHT);
+	ErrorCheck(vkAllocateCommandBuffers(_renderer->GetDevice(), &blit_allocate_info, &_blit_command_buffers[0]), "Unable to allocated blit command buffers.");
+
 	VkCommandPoolCreateInfo cmd_pool_create_info = {};
 	cmd_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	cmd_pool_create_info.pNext = nullptr;
@@ -236,6 +383,11 @@ void Presentation::_CreateCommandPoolAndBuffers()
 	cmd_pool_create_info.queueFamilyIndex = _renderer->GetGraphicsFamilyIndex();
 	ErrorCheck(vkCreateCommandPool(_renderer->GetDevice(), &cmd_pool_create_info, nullptr, &_present_queue_command_pool), "Unable to create a command pool.", "Presentation queue command pool successfully created.");
 
+	_AllocateCommandBuffers();
+}
+
+void Presentation::_AllocateCommandBuffers()
+{
 	_present_queue_command_buffers.resize(_swapchain_image_count);
 
 
@@ -338,4 +490,49 @@ void Presentation::_CreatePresentationSampler()
 	ErrorCheck(vkCreateSampler(_renderer->GetDevice(), &sampler_create_info, nullptr, &_sampler), "Unable to create presentation image sampler.", "Presentation image sampler created.");
 }
 
+void Presentation::_RecordBlit(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, uint32_t image_index)
+{
+	VkCommandBufferBeginInfo cmd_buffer_begin_info = Structs::CommandBufferBeginInfo();
+	VkImageSubresourceRange image_subresource_range = Structs::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+
+	VkImageMemoryBarrier barrier_from_present_to_blit = {
+		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // VkStructureType                        sType
+		nullptr,                                    // const void                            *pNext
+		0,                                          // VkAccessFlags                          srcAccessMask
+		VK_ACCESS_TRANSFER_WRITE_BIT,               // VkAccessFlags                          dstAccessMask
+		VK_IMAGE_LAYOUT_UNDEFINED,                  // VkImageLayout                          oldLayout
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,       // VkImageLayout                          newLayout
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               srcQueueFamilyIndex
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               dstQueueFamilyIndex
+		_swapchain_images[image_index],             // VkImage                                image
+		image_subresource_range                     // VkImageSubresourceRange                subresourceRange
+	};
+
+	VkImageMemoryBarrier barrier_from_blit_to_present = {
+		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // VkStructureType                        sType
+		nullptr,                                    // const void                            *pNext
+		VK_ACCESS_TRANSFER_WRITE_BIT,               // VkAccessFlags                          srcAccessMask
+		VK_ACCESS_MEMORY_READ_BIT,                  // VkAccessFlags                          dstAccessMask
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,       // VkImageLayout                          oldLayout
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,            // VkImageLayout                          newLayout
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               srcQueueFamilyIndex
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               dstQueueFamilyIndex
+		_swapchain_images[image_index],             // VkImage                                image
+		image_subresource_range                     // VkImageSubresourceRange                subresourceRange
+	};
 
+	// scales when the traced image and the swapchain disagree, and converts to the swapchain format.
+	VkImageBlit region = {};
+	region.srcSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.srcOffsets[1]	= { (int32_t)extent.width, (int32_t)extent.height, 1 };
+	region.dstSubresource	= { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstOffsets[1]	= { (int32_t)_surface_size_x, (int32_t)_surface_size_y, 1 };
+
+	ErrorCheck(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info), "Unable to begin blit command buffer.");
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_present_to_blit);
+	vkCmdBlitImage(command_buffer, image, VK_IMAGE_LAYOUT_GENERAL, _swapchain_images[image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_blit_to_present);
+
+	vkEndCommandBuffer(command_buffer);
+}
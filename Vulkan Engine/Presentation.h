@@ -1,8 +1,10 @@
 #pragma once
 
+#include "src\BUILD_OPTIONS.h"
 #include "src\Platform.h"
 #include "src\Shared.h"
 #include "src\Renderer.h"
+#include "src\base\MemoryAllocator.h"
 #include "src\base\helpers\Structs.h"
 
 #include <vector>
@@ -20,38 +22,52 @@ private:
 	VkCommandPool						_present_queue_command_pool;
 	std::vector<VkCommandBuffer>		_present_queue_command_buffers;
 
+	// blit of the traced image, recorded per frame in flight.
+	VkCommandPool						_blit_command_pool								= VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer>		_blit_command_buffers;
+
 	VkSwapchainKHR						_swapchain										= VK_NULL_HANDLE;
 	uint32_t							_swapchain_image_count							= 2;
 	std::vector<VkImage>				_swapchain_images;
 	std::vector<VkImageView>			_swapchain_image_views;
+	VkDeviceSize						_swapchain_memory								= 0;		// estimated, the driver allocates the images
 	VkSampler							_sampler;
 
-	VkSemaphore							_semaphore_image_available						= VK_NULL_HANDLE;
-	VkSemaphore							_semaphore_rendering_finished					= VK_NULL_HANDLE;
+	// one pair per frame in flight.
+	std::vector<VkSemaphore>			_semaphores_image_available;
+	std::vector<VkSemaphore>			_semaphores_rendering_finished;
+	uint32_t							_frame_index									= 0;
 
 	uint32_t                            _current_image                                  = 0;
 	uint32_t                            _previous_image                                 = 0;
 
+	// set when the swapchain was recreated here, out of date or suboptimal, instead of by the window.
+	bool								_recreated										= false;
+
 public:
 	Presentation(Renderer * renderer, VkSurfaceKHR surface, VkSurfaceCapabilitiesKHR surface_capabilities, VkSurfaceFormatKHR format, uint32_t surface_x, uint32_t surface_y);
 	~Presentation();
 
 	uint32_t                            PreviousFrame();
-	uint32_t							PrepareFrame();
+	bool								PrepareFrame(uint32_t & image_index);
 	void								RenderFrame(uint32_t image_index);
 	void								Clear();
+	void								Present(VkImage image, VkExtent2D extent, VkSemaphore image_ready, VkFence fence);
+	bool								Resize(uint32_t surface_x, uint32_t surface_y);
+	bool								WasRecreated();
 
-	VkDescriptorImageInfo				GetPresentationImageDescriptor(uint32_t image_index);
 	std::vector<VkImage>				GetSwapchainImages();
+	VkExtent2D							GetExtent();
 	std::vector<VkImageView>			GetSwapchainImageViews();
 	VkSemaphore				&			GetSemaphoreRenderingFinished();
 	VkSemaphore				&			GetSemaphoreImageAvailable();
+	uint32_t							GetFrameIndex();
 	VkSampler							GetPresentationSampler();
 
 private:
 	Renderer				*			_renderer				= nullptr;
 
-	void								_InitSwapChain();
+	void								_InitSwapChain(VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
 	void								_DeInitSwapChain();
 
 	void								_InitSwapChainImages();
@@ -61,7 +77,9 @@ private:
 	void								_CreatePresentationSampler();
 
 	void								_CreateCommandPoolAndBuffers();
+	void								_AllocateCommandBuffers();
 	void								_RecordCommandBuffers();
+	void								_RecordBlit(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, uint32_t image_index);
 
 };
 
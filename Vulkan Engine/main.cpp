@@ -13,28 +13,235 @@
 #include "src/Platform.h"
 #include "src/Texture.h"
 #include "src/PathTracer.h"
+#include "src/Distributed.h"
+#include "src/TextureConverter.h"
 
-int main()
+int main(int argc, char ** argv)
 {
+	// -o <file>                       render to file ( .pfm, .exr, .png ) and exit.
+	// -spp <count>                    samples per pixel before the file is written.
+	// -checkpoint <file>              resume from the file if it exists, and keep it updated.
+	// -checkpoint-interval <seconds>  time between checkpoints.
+	// -size <width> <height>          with -o, render an image of any size in window sized tiles ( .pfm, .exr ).
+	// -jobs <count>                   with -o, split the samples over worker processes and merge their partials, with -size split the tiles.
+	// -tile-worker <index> <count>    with -size, render every count-th tile from index into the existing file.
+	// -gpus <count>                   with -jobs, spread the workers over this many gpus.
+	// -gpu <index>                    gpu to render on.
+	// -sample-offset <index>          first sample of this render, disjoint ranges can be merged.
+	// -merge <file> <partials...>     merge .ckpt partials into an image or checkpoint and exit.
+	// -preview <scale>                trace 1 / scale of the resolution while the camera moves, 1 turns it off.
+	// -resolution <width> <height>    window and render resolution.
+	// -quality <preset>               draft, medium, high or ultra.
+	// -budget <milliseconds>          gpu time per presented frame, filled with as many samples as fit. 0 traces one.
+	// -wavefront                      trace with separate raygen, extend, shade and shadow kernels instead of one.
+	// -persistent <workgroups>        launch only this many workgroups, they fetch pixels until none are left. 0 follows the grid.
+	// -packed-scene                   read planes and spheres stored with fp16 colors and octahedral normals.
+	// -texture <file>                 stream a texture in while rendering, can be given several times.
+	// -convert <in> <out> <format>    encode an image with mips into a .ktx2 ( bc1 or bc5 ) and exit.
+	std::string output_file;
+	uint32_t    output_samples      = 256;
+	bool        output_saving       = false;
+	std::string checkpoint_file;
+	float       checkpoint_interval = 60.0f;
+	uint32_t    image_width         = 0;
+	uint32_t    image_height        = 0;
+	uint32_t    jobs                = 0;
+	uint32_t    tile_worker_index   = 0;
+	uint32_t    tile_worker_count   = 0;
+	uint32_t    gpu_count           = 1;
+	uint32_t    gpu_index           = 0;
+	uint32_t    sample_offset       = 0;
+	uint32_t    preview_scale       = 2;
+	uint32_t    width               = 800;
+	uint32_t    height              = 600;
+	float       sample_budget       = -1.0f;
+	std::string quality_name;
+	bool        wavefront           = false;
+	uint32_t    persistent_groups   = 0;
+	bool        packed_scene        = false;
+	std::vector<std::string> texture_files;
+	std::vector<std::string> merge_files;
+	std::vector<std::string> convert_files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if ((arg == "-o" || arg == "--output") && i + 1 < argc)									output_file				= argv[++i];
+		else if ((arg == "-spp" || arg == "--spp") && i + 1 < argc)								output_samples			= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-checkpoint" || arg == "--checkpoint") && i + 1 < argc)					checkpoint_file			= argv[++i];
+		else if ((arg == "-checkpoint-interval" || arg == "--checkpoint-interval") && i + 1 < argc)	checkpoint_interval		= std::stof(argv[++i]);
+		else if ((arg == "-size" || arg == "--size") && i + 2 < argc)
+		{
+			image_width		= (uint32_t)std::stoul(argv[++i]);
+			image_height	= (uint32_t)std::stoul(argv[++i]);
+		}
+		else if ((arg == "-resolution" || arg == "--resolution") && i + 2 < argc)
+		{
+			width			= (uint32_t)std::stoul(argv[++i]);
+			height			= (uint32_t)std::stoul(argv[++i]);
+		}
+		else if ((arg == "-jobs" || arg == "--jobs") && i + 1 < argc)								jobs					= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-tile-worker" || arg == "--tile-worker") && i + 2 < argc)
+		{
+			tile_worker_index	= (uint32_t)std::stoul(argv[++i]);
+			tile_worker_count	= (uint32_t)std::stoul(argv[++i]);
+		}
+		else if ((arg == "-gpus" || arg == "--gpus") && i + 1 < argc)								gpu_count				= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-gpu" || arg == "--gpu") && i + 1 < argc)									gpu_index				= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-sample-offset" || arg == "--sample-offset") && i + 1 < argc)			sample_offset			= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-preview" || arg == "--preview") && i + 1 < argc)							preview_scale			= (uint32_t)std::stoul(argv[++i]);
+		else if ((arg == "-quality" || arg == "--quality") && i + 1 < argc)							quality_name			= argv[++i];
+		else if ((arg == "-budget" || arg == "--budget") && i + 1 < argc)							sample_budget			= std::stof(argv[++i]);
+		else if (arg == "-wavefront" || arg == "--wavefront")										wavefront				= true;
+		else if ((arg == "-persistent" || arg == "--persistent") && i + 1 < argc)					persistent_groups		= (uint32_t)std::stoul(argv[++i]);
+		else if (arg == "-packed-scene" || arg == "--packed-scene")								packed_scene			= true;
+		else if ((arg == "-texture" || arg == "--texture") && i + 1 < argc)							texture_files.push_back(argv[++i]);
+		else if ((arg == "-convert" || arg == "--convert") && i + 3 < argc)
+		{
+			convert_files.assign(argv + i + 1, argv + i + 4);
+			i += 3;
+		}
+		else if ((arg == "-merge" || arg == "--merge") && i + 2 < argc)
+		{
+			merge_files.assign(argv + i + 1, argv + argc);
+			break;
+		}
+	}
+
+	// merging and launching workers need no device of their own.
+	if (!merge_files.empty())
+	{
+		std::string merged_file = merge_files[0];
+		merge_files.erase(merge_files.begin());
+		return Distributed::Merge(merge_files, merged_file) ? 0 : 1;
+	}
+
+	// neither does converting textures.
+	if (!convert_files.empty())
+	{
+		TextureConverter::Format format;
+		if (!TextureConverter::ParseFormat(convert_files[2], format))
+		{
+			std::cout << "Unknown texture format \"" << convert_files[2] << "\", use bc1 or bc5." << std::endl;
+			return 1;
+		}
+		return TextureConverter::Convert(convert_files[0], convert_files[1], format) ? 0 : 1;
+	}
+
+	PathTracer::Quality quality = PathTracer::QUALITY_HIGH;
+	if (!quality_name.empty() && !PathTracer::ParseQuality(quality_name, quality))
+	{
+		std::cout << "Unknown quality \"" << quality_name << "\", use draft, medium, high or ultra." << std::endl;
+		return 1;
+	}
+
+	// a process accumulates at most the preset's FRAME_COUNT, sample ranges split over jobs get that many each.
+	uint32_t max_samples = PathTracer::GetMaxSamples(quality) * (jobs > 0 && image_width == 0 ? jobs : 1);
+	if (!output_file.empty() && output_samples > max_samples)
+	{
+		std::cout << "-spp " << output_samples << " is more than the quality preset accumulates, rendering " << max_samples << " samples." << std::endl;
+		output_samples = max_samples;
+	}
+
+	// tiled renders split their tiles, the workers write them straight into the output file.
+	if (jobs > 0 && !output_file.empty() && image_width > 0 && image_height > 0)
+		return Distributed::RunTiles(output_file, width, height, image_width, image_height, output_samples, sample_offset, jobs, gpu_count, Distributed::WorkerArguments(argc, argv)) ? 0 : 1;
+
+	if (jobs > 0 && !output_file.empty())
+		return Distributed::Run(output_file, width, height, output_samples, sample_offset, jobs, gpu_count, Distributed::WorkerArguments(argc, argv)) ? 0 : 1;
+
 	// create our renderer
-	Renderer renderer;
+	Renderer renderer(gpu_index);
 
 	// open a window & clear it
-	renderer.OpenWindow(800, 600, "Avol Vulkan Engine 0.05");
+	renderer.OpenWindow(width, height, "Avol Vulkan Engine 0.05");
 	renderer.GetWindow()->GetPresentation()->Clear();
 
-	// create our pathtracer
-	PathTracer * path_tracer = new PathTracer(&renderer, 800, 600);
+	// create our pathtracer, at the size the surface actually got. the scene layout is known before its pipelines get built.
+	VkExtent2D extent = renderer.GetWindow()->GetPresentation()->GetExtent();
+	PathTracer * path_tracer = new PathTracer(&renderer, extent.width, extent.height, packed_scene);
+	path_tracer->SetSampleOffset(sample_offset);
+	path_tracer->SetPreviewScale(preview_scale);
+	path_tracer->SetQuality(quality);
+	path_tracer->SetWavefront(wavefront);
+	path_tracer->SetPersistentGroups(persistent_groups);
+	for (std::string & texture_file : texture_files)
+		path_tracer->LoadTexture(texture_file);
+
+	// renders to file are not throttled by the display refresh rate unless asked to.
+	if (sample_budget < 0.0f)
+		sample_budget = output_file.empty() ? 0.0f : 12.0f;
+	path_tracer->SetSampleBudget(sample_budget);
+
+	renderer.PrintMemoryReport();
+
+	// tiled offline render, the window only previews the current tile.
+	bool tiled = !output_file.empty() && image_width > 0 && image_height > 0;
+	if (tiled)
+	{
+		if (!path_tracer->RenderTiles(output_file, image_width, image_height, output_samples, tile_worker_index, tile_worker_count))
+		{
+			delete path_tracer;
+			return 1;
+		}
+		output_file.clear();
+	}
+
+	// continue where a killed run stopped.
+	else if (!checkpoint_file.empty())
+	{
+		if (Checkpoint::Exists(checkpoint_file))
+			path_tracer->Resume(checkpoint_file);
+		path_tracer->SetCheckpoint(checkpoint_file, checkpoint_interval);
+	}
+
+	// the file gets exactly the requested samples, batches stop short of overshooting them.
+	if (!output_file.empty())
+		path_tracer->SetSampleLimit(output_samples);
 
 	std::cout << "-------------------------------------- Rendering -----------------------------------" << std::endl;
 
+	// a distributed render only merges workers that got to the end.
+	bool completed = false;
+	bool reload_down = false;
+
 	while ( renderer.Run() ) 
 	{
 		auto begin = std::chrono::high_resolution_clock::now();
 
+		// swapchain follows the window, nothing to render while minimized.
+		if (renderer.GetWindow()->RecreateSwapchain())
+		{
+			VkExtent2D extent = renderer.GetWindow()->GetPresentation()->GetExtent();
+			path_tracer->Resize(extent.width, extent.height);
+		}
+		if (renderer.GetWindow()->IsMinimized())
+		{
+			Sleep(16);
+			continue;
+		}
+
+		// F5 picks up shaders rebuilt with compile.bat, without waiting for the gpu. once per press, and only in the focused window.
+		bool reload = GetForegroundWindow() == renderer.GetWindow()->GetHandle() && (GetAsyncKeyState(VK_F5) & 0x8000) != 0;
+		if (reload && !reload_down)
+			path_tracer->ReloadPipelines();
+		reload_down = reload;
 
 		path_tracer->Dispatch();
 
+		// request the file once, then keep rendering until the writer is done with it.
+		if (!output_file.empty() && path_tracer->GetSampleCount() >= output_samples)
+		{
+			path_tracer->SaveImage(output_file);
+			output_file.clear();
+			output_saving = true;
+		}
+		else if ((output_saving && !path_tracer->IsSaving()) || (tiled && path_tracer->IsFinished()))
+		{
+			completed = true;
+			break;
+		}
+
 
 		std::stringstream ss;
 		auto end = std::chrono::high_resolution_clock::now();
@@ -42,5 +249,7 @@ int main()
 		std::cout << ss.str().c_str() << std::endl;
 	}
 
-	return 0;
+	delete path_tracer;
+
+	return (output_saving || tiled) && !completed ? 1 : 0;
 }
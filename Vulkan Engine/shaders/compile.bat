@@ -1,2 +1,23 @@
-glslangValidator pathtracer.comp -V -o pathtracer.comp.spv
-set /p done=press enter...
\ No newline at end of file
+@echo off
+rem run from anywhere, the pre-build step passes -nopause so the build does not wait for input.
+cd /d "%~dp0"
+set failed=0
+
+glslangValidator pathtracer.comp -V -o pathtracer.comp.spv || set failed=1
+glslangValidator upsample.comp -V -o upsample.comp.spv || set failed=1
+glslangValidator wavefront_raygen.comp -V -o wavefront_raygen.comp.spv || set failed=1
+glslangValidator wavefront_extend.comp -V -o wavefront_extend.comp.spv || set failed=1
+glslangValidator wavefront_queues.comp -V -o wavefront_queues.comp.spv || set failed=1
+glslangValidator wavefront_shade.comp -V -o wavefront_shade.comp.spv || set failed=1
+glslangValidator wavefront_shadow.comp -V -o wavefront_shadow.comp.spv || set failed=1
+glslangValidator wavefront_resolve.comp -V -o wavefront_resolve.comp.spv || set failed=1
+glslangValidator pathtracer.comp -V -DBINDLESS -o pathtracer.bindless.comp.spv || set failed=1
+glslangValidator wavefront_raygen.comp -V -DBINDLESS -o wavefront_raygen.bindless.comp.spv || set failed=1
+glslangValidator wavefront_extend.comp -V -DBINDLESS -o wavefront_extend.bindless.comp.spv || set failed=1
+glslangValidator wavefront_queues.comp -V -DBINDLESS -o wavefront_queues.bindless.comp.spv || set failed=1
+glslangValidator wavefront_shade.comp -V -DBINDLESS -o wavefront_shade.bindless.comp.spv || set failed=1
+glslangValidator wavefront_shadow.comp -V -DBINDLESS -o wavefront_shadow.bindless.comp.spv || set failed=1
+glslangValidator wavefront_resolve.comp -V -DBINDLESS -o wavefront_resolve.bindless.comp.spv || set failed=1
+
+if not "%1"=="-nopause" set /p done=press enter...
+exit /b %failed%
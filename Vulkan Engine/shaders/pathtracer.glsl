@@ -0,0 +1,802 @@
+// shared by the megakernel pathtracer.comp and the wavefront_*.comp kernels.
+// compiled twice, -DBINDLESS indexes material textures with VK_EXT_descriptor_indexing.
+
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : enable
+#endif
+
+// enums for surfaces
+const uint          SOLID                                   = 0x00000001u;
+const uint          TRANSLUCENT                             = 0x00000002u;
+const uint          REFLECTIVE                              = 0x00000004u;
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------------- DEFINITIONS -------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+#define         PI                                       3.1415926535897932384626433832795
+#define         PI2                                      6.283185307179586
+#define         RADIAN                                   0.0174533
+
+#define         FRAME_PROGRESSION                        1.0f
+#define         BIAS									 0.001f
+
+// notice: this should be defined before shader is compiled
+//         the recalculation of this is needed, since using uniform count introduces significant decrease in performance.
+//         SBO's would likely solve this problem with ease.
+#define         PLANE_COUNT                              6
+#define         SPHERE_COUNT                             4
+
+#define         REFRACTION_ETA                           0.71428571428
+
+#define         INDIRECT_INTENSITY				         4.0f
+
+#define         PREVIEW_FAR                              10000.0f                                       // guide depth of rays that hit nothing
+
+#define         MATERIAL_TEXTURE_SLOTS                   16                                             // same as BUILD_MATERIAL_TEXTURE_SLOTS
+#define         MATERIAL_UV_SCALE                        0.5f                                           // plane textures repeat every 1 / scale world units
+
+// quality knobs, specialized per pipeline by PathTracer::_CreatePipeline(). values here are the high preset.
+layout (constant_id = 0) const int  FRAME_COUNT                = 1000;
+layout (constant_id = 1) const int  BOUNCE_COUNT               = 2;
+layout (constant_id = 2) const int  RAY_COUNT                  = 4;                                  // 4 to 8 is enough.
+layout (constant_id = 3) const bool CAUSTICS                   = true;
+layout (constant_id = 4) const int  MAX_BOUNCE_PER_TRACE       = 5;
+layout (constant_id = 7) const bool PACKED_SCENE               = false;                              // read planes and spheres from their packed copies
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------------- STRUCTS -------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+struct Ray 
+{
+	vec3 origin;
+	vec3 direction;
+};
+
+struct Light
+{
+    int   type;
+	vec3  direction;
+	vec3  position;
+	float radius;
+	vec3  color;
+	float constantAttenuation;
+	float linearAttenuation;
+    float quadraticAttenuation;
+};
+
+struct Intersection
+{
+    uint type;
+    vec3 point;
+    vec3 normal;
+    vec3 reflection;
+	vec3 refraction;
+    float range;
+    vec4 albedo;
+	vec4 specular;
+	vec4 redf;
+	int  texture;                                                          // albedo texture, -1 none
+	vec2 uv;
+	float uvDensity;                                                       // uv units per world unit around the hit, picks the mip
+};
+
+struct Plane
+{
+	vec4 normal;
+	vec4 position;
+	vec4 albedo;
+	vec4 specular;
+	vec4 redf;
+	ivec4 material;                                                        // x = albedo texture, -1 none
+};
+
+struct Sphere
+{
+	vec4 position;
+	vec4 albedo;
+	vec4 specular;
+	vec4 redf;
+	ivec4 material;                                                        // x = albedo texture, -1 none
+};
+
+// same layout as PackedScene on the cpu side.
+struct PackedMaterial
+{
+	uvec4 colors;                                                          // albedo rg, albedo ba, specular rg, specular ba as fp16 pairs
+	uint  factors;                                                         // redf as unorm8
+	int   texture;                                                         // albedo texture, -1 none
+};
+
+struct PackedPlane
+{
+	vec3           position;
+	uint           normal;                                                 // octahedral, two snorm16
+	PackedMaterial material;
+};
+
+struct PackedSphere
+{
+	vec4           position;                                               // w = radius
+	PackedMaterial material;
+};
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------------ Uniforms -------------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+layout (binding = 0, rgba32f) uniform image2D accumulationImage;       // rgb = mean color, a = sample count
+layout (binding = 1, rgba8) uniform image2D resultImage;               // displayed color, blitted to the swapchain
+layout (binding = 6, rgba32f) uniform image2D previewImage;            // low resolution color while the camera moves
+layout (binding = 7, rgba32f) uniform image2D guideImage;              // xyz = primary hit normal, w = primary hit depth
+
+
+// camera and tile of the frame, bound at an offset into the per frame ring.
+layout(std140, binding = 2) uniform ViewData
+{
+	mat4    inverse_projection_view;
+    vec2    image_resolution;                                              // whole image, differs from resolution when tiled
+    vec2    tile_offset;
+} view;
+
+// pushed with every dispatch, at most 128 bytes.
+layout(push_constant) uniform Data
+{
+    vec2    resolution;
+	int     frame;
+    float   time;
+    int     sample_offset;                                                 // first sample of this worker's range
+    int     preview_scale;                                                 // > 1 traces one pixel per scale x scale block
+    int     samples;                                                       // samples accumulated by one dispatch, starting at frame
+    int     path_offset;                                                   // wavefront, first pixel of the paths in flight
+    int     queue;                                                         // wavefront, ray queue extended this bounce
+    int     stage;                                                         // wavefront, queue update after extend or after shade
+    int     persistent;                                                    // 1 fetches pixels from a counter instead of following the grid
+    int     texture_count;                                                 // material textures slots handed out, loaded or not
+} data;
+
+// frame of the sample being traced, one dispatch traces data.samples of them.
+int             sampleFrame;
+
+// random sequence index, frame only counts the samples accumulated here.
+#define         SAMPLE_INDEX                             (sampleFrame + data.sample_offset)
+
+layout(std140, binding = 3) uniform LightData
+{
+	vec4  position;
+    vec4  color;
+    vec4  direction;
+	float radius;
+	float constantAttenuation;
+	float linearAttenuation;
+    float quadraticAttenuation;
+    int   type;
+} _light;
+
+layout(binding = 4) uniform PlaneData
+{
+	Plane planes[ PLANE_COUNT ];
+} _planes;
+
+layout(binding = 5) uniform SphereData
+{
+	Sphere spheres[ SPHERE_COUNT ];
+} _spheres;
+
+layout(std140, binding = 14) uniform PackedPlaneData
+{
+	PackedPlane planes[ PLANE_COUNT ];
+} _packedPlanes;
+
+layout(std140, binding = 15) uniform PackedSphereData
+{
+	PackedSphere spheres[ SPHERE_COUNT ];
+} _packedSpheres;
+
+// material textures in their own set, slots that are still loading hold a white texture.
+#ifdef BINDLESS
+layout(set = 1, binding = 0) uniform sampler2D materialTextures[];
+#else
+layout(set = 1, binding = 0) uniform sampler2D materialTextures[ MATERIAL_TEXTURE_SLOTS ];
+#endif
+
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------------ Helper Functions --------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+// Transforms camera local coordinate to world space position.
+// @ m = inverse projection matrix of the camera.
+vec3 screenToWorld(mat4x4 m, vec3 v)
+{
+	vec3 sPoint	    = v * 2.0f - 1.0f;
+
+	vec4 wPoint	    = m * vec4(sPoint, 1.0f);
+	wPoint			/= wPoint.w;
+
+	return wPoint.xyz;
+}
+
+float random(vec3 scale, float seed, vec3 pixelSeed)
+{
+    return fract( sin( dot(pixelSeed + vec3(seed), scale) ) * 43758.5453f + seed );
+}
+
+float Hash( float n )
+{
+    return fract( sin(n) * 43758.5453123 );
+}
+
+
+vec3 CosineDirection( float seed, vec3 normal, vec3 pixelSeed, Intersection intersection, out float pdf )
+{
+    float Xi1 = random(vec3(12.9898, 78.233, 151.7182), seed, pixelSeed);
+    float Xi2 = random(vec3(63.7264, 10.873, 623.6736), seed, pixelSeed);
+
+	// phong importnce smpling.
+	float power = 16.0f * (1.0f - intersection.redf.r);
+	power *= power;
+
+    float theta = acos(pow(Xi1, 1.0f/(power+1.0f)));              // phong
+	//float theta = acos(sqrt(1.0-Xi1));                          // lmbertin
+
+    float phi = 2.0 * PI * Xi2;
+
+    float xs = sin(theta) * cos(phi);
+    float ys = cos(theta);
+    float zs = sin(theta) * sin(phi);
+
+    vec3 y = normal;
+    vec3 h = y;
+    if (abs(h.x)<=abs(h.y) && abs(h.x)<=abs(h.z))
+        h.x= 1.0;
+    else if (abs(h.y)<=abs(h.x) && abs(h.y)<=abs(h.z))
+        h.y= 1.0;
+    else
+        h.z= 1.0;
+
+    vec3 x = normalize( cross(h, y) );
+    vec3 z = normalize( cross(x, y) );
+
+	// lmbertin
+    //vec3 direction = xs * x + ys * y + zs * z;
+
+	// phong
+	vec3 direction = cos(phi)*sin(theta)*x
+        + sin(phi)*sin(theta)*z
+        + cos(theta)*intersection.reflection;
+  //  vec3 direction2 = result;
+
+    pdf = pow(Xi1, 1.0f/(power+1.0f));//(power+2)/(power+1);
+
+    return normalize(direction);
+}
+
+// random normalized vector
+vec3 UniformHemisphere(float seed, vec3 pixelSeed)
+{
+   float u = random(vec3(12.9898, 78.233, 151.7182), seed, pixelSeed);
+   float v = random(vec3(63.7264, 10.873, 623.6736), seed, pixelSeed);
+   float z = 1.0 - 2.0 * u;
+   float r = sqrt(1.0 - z * z);
+   float theta = 6.283185307179586 * v;
+   return vec3(r * cos(theta), r * sin(theta), z) * sqrt(random(vec3(36.7539, 50.3658, 306.2759), seed, pixelSeed));
+}
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------- Shading Functions ---------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+vec3 computeDiffuse(vec3 point, vec3 normal, Light light)
+{
+	 vec3 diffuse              = clamp( vec3( dot( normalize(point + light.position), normal)  ), 0.0f, 1.0f );
+	 diffuse                   *= light.color;
+	 return diffuse;
+}
+
+// http://www.filmicworlds.com/2014/04/21/optimizing-ggx-shaders-with-dotlh/
+// GGX Shading model.
+float G1V(float dotNV, float k)
+{
+    return 1.0f / (dotNV*(1.0f-k)+k);
+}
+
+// Computes specular color.
+// http://www.filmicworlds.com/2014/04/21/optimizing-ggx-shaders-with-dotlh/
+// TODO: further optimize based on this article.
+// GGX specular shading model.
+// L = light dir.
+vec3 computeSpecular(Ray ray, Light light, vec3 point, vec3 normal, float roughness, float F0)
+{
+    if (dot(ray.direction, normal) < 0)
+	    return vec3(0);
+
+    vec3 LP = -normalize(point + light.position);
+
+    vec3 H = normalize(ray.direction - LP); // half vec
+
+	roughness += 0.05f; // make sure it's not 0, otherwise artifacts.
+    float alpha = roughness * roughness;
+
+    float dotNL = clamp(dot(normal, -LP), 0.0f, 1.0f);
+    float dotNV = clamp(dot(normal, ray.direction), 0.0f, 1.0f);
+    float dotNH = clamp(dot(normal, H), 0.0f, 1.0f);
+    float dotLH = clamp(dot(-LP, H), 0.0f, 1.0f);
+
+    float F, D, vis;
+
+    // D - GGX distribution
+    float alphaSqr = alpha*alpha;
+    float denom = (dotNH * dotNH) * (alphaSqr-1.0f) + 1.0f;
+    D = alphaSqr/(PI*denom*denom);
+
+	// D - Blinn
+	//D = pow(dotNH, 16);
+
+    // F - schlick fresnel
+	// with spherical gaussian approximation.
+    float dotLH5 = pow(1.0f-dotLH, 5);
+    F = F0 + (1.0f - F0) * pow(2, (-5.55473 * (dot(ray.direction, H)) - 6.98316) * (dot(ray.direction, H)));
+
+    // V - Schlick approximation of Smith solved with GGX
+    float k = alpha/2.0f;
+    vis = G1V(dotNL, k) * G1V(dotNV, k);
+
+	// Combine
+    float specularFactor = dotNL * D * F * vis;
+
+    return vec3(specularFactor);
+}
+
+// Compute light attenuation cofficient.
+// v = world vertex
+float computeAttenuation(Light light, vec3 v, float traveled)
+{
+    float distance = length(light.position + v) + traveled;
+    float attenuation = 2 / (light.constantAttenuation + light.linearAttenuation * distance
+                         + light.quadraticAttenuation * distance * distance);
+
+    attenuation = clamp(1.0 - distance/light.radius, 0.0, 1.0);
+   return attenuation;
+}
+
+// Compute schlick fresnel.
+// P = world position
+// E = camera eye position.
+// F0 = fresnel reflectance.
+float computeFresnel(vec3 P, vec3 E, vec3 N, float F0) 
+{
+	vec3 I = -normalize(P - E);
+	N = normalize(N);
+	float fresnel = F0 * pow(1 + dot(I, N), 5);
+    return 1.0f - fresnel;
+}
+
+// Angle between the camera rays of two neighbouring traced pixels, preview pixels cover scale x scale of them.
+float pixelSpreadAngle()
+{
+	vec2 step    = vec2(0.0f, float(data.preview_scale) / data.resolution.y);
+	vec3 nearPos = screenToWorld( view.inverse_projection_view, vec3(0.5f, 0.5f, 0.0f) );
+	vec3 center  = normalize( screenToWorld( view.inverse_projection_view, vec3(0.5f, 0.5f, 1.0f) ) - nearPos );
+	vec3 next    = normalize( screenToWorld( view.inverse_projection_view, vec3(vec2(0.5f) + step, 1.0f) ) - nearPos );
+	return length(next - center);
+}
+
+// Mip whose texels match the footprint of a pixel's ray cone at the hit, widened at grazing angles.
+// Only the last ray segment widens the cone, hits after a bounce get a sharper mip than they should.
+float materialTextureLod(Ray ray, Intersection intersection, vec2 textureResolution)
+{
+	float cosine    = max(abs(dot(ray.direction, intersection.normal)), 0.1f);
+	float footprint = pixelSpreadAngle() * intersection.range / cosine;
+	return max(log2(footprint * intersection.uvDensity * max(textureResolution.x, textureResolution.y)), 0.0f);
+}
+
+// Albedo of a material texture, repeated over the surface.
+// bindless indexes the array with the texture of each hit, the fixed array is walked with a uniform index instead.
+vec4 sampleMaterialTexture(Ray ray, Intersection intersection)
+{
+	int  index = intersection.texture;
+	vec2 uv    = fract(intersection.uv);
+#ifdef BINDLESS
+	vec2 size  = vec2(textureSize(materialTextures[nonuniformEXT(index)], 0));
+	return textureLod(materialTextures[nonuniformEXT(index)], uv, materialTextureLod(ray, intersection, size));
+#else
+	vec4 color = vec4(1.0f);
+	for (int i = 0; i < MATERIAL_TEXTURE_SLOTS; i++)
+	{
+		if (i == index)
+			color = textureLod(materialTextures[i], uv, materialTextureLod(ray, intersection, vec2(textureSize(materialTextures[i], 0))));
+	}
+	return color;
+#endif
+}
+
+// Applied to the closest hit only, the other hits of a ray never get shaded.
+void applyMaterialTexture(Ray ray, inout Intersection intersection)
+{
+	if (intersection.texture >= 0 && intersection.texture < data.texture_count)
+		intersection.albedo.rgb *= sampleMaterialTexture(ray, intersection).rgb;
+}
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------- Geometry Functions --------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+//
+//
+//
+//
+bool intersectSphere(Ray ray, Sphere sphere, inout Intersection intersection)
+{
+    vec3 oc		= ray.origin + sphere.position.xyz;
+    float b		= 2.0 * dot(ray.direction, oc);
+    float c		= dot(oc, oc) - sphere.position.w * sphere.position.w;
+    float disc	= b * b - 4.0 * c;
+
+    if (disc < 0.0)
+        return false;
+
+    float q;
+    if (b < 0.0)
+        q = (-b - sqrt(disc))/2.0;
+    else
+        q = (-b + sqrt(disc))/2.0;
+
+    float t0 = q;
+    float t1 = c / q;
+
+	// if t0 is bigger than t1 swap them around
+    if (t0 > t1) 
+	{    
+        float temp = t0;
+        t0 = t1;
+        t1 = temp;
+    }
+
+    // if t1 is less than zero, the object is in the ray's negative direction
+    // and consequently the ray misses the sphere
+    if (t1 < 0.0)
+        return false;
+
+    // store intersection data
+    t0 < 0.0 ? intersection.range = t1 : intersection.range = t0;
+	intersection.point       = ray.origin + ray.direction * intersection.range;
+	intersection.normal      = -normalize(sphere.position.xyz + intersection.point);
+	intersection.reflection  = reflect( ray.direction, intersection.normal );
+
+	vec3 invertedNormal       = dot(ray.direction, intersection.normal) <= 0 ? intersection.normal : -intersection.normal;
+    intersection.refraction   = normalize(refract(ray.direction, invertedNormal, REFRACTION_ETA));
+
+	intersection.type         = sphere.specular.a > 0 ? REFLECTIVE : sphere.albedo.a < 1.0f ? TRANSLUCENT : SOLID;
+    intersection.albedo       = sphere.albedo;
+	intersection.specular     = sphere.specular;
+    intersection.redf         = sphere.redf;
+
+	// spherical coordinates around the center.
+	vec3 local                = normalize(intersection.point + sphere.position.xyz);
+	intersection.texture      = sphere.material.x;
+	intersection.uv           = vec2(atan(local.z, local.x) / PI2 + 0.5f, acos(clamp(local.y, -1.0f, 1.0f)) / PI);
+	intersection.uvDensity    = 1.0f / (PI * sphere.position.w);
+
+	return true;
+}
+
+
+//
+//
+//
+//
+
+bool intersectPlane(Ray ray, Plane plane, inout Intersection intersection)
+{
+   float d = -dot(-plane.position.xyz, plane.normal.xyz);
+   float v = dot(ray.direction, plane.normal.xyz);
+   float t = -(dot(ray.origin, plane.normal.xyz) + d) / v;
+
+   if(t > 0.0)
+   {
+      intersection.range		= t;
+      intersection.point		= ray.origin + ray.direction * t;
+      intersection.normal		= plane.normal.xyz; 
+      intersection.reflection	= reflect( ray.direction, plane.normal.xyz ); 
+
+	  vec3 invertedNormal       = dot(ray.direction, intersection.normal) <= 0 ? intersection.normal : -intersection.normal;
+      intersection.refraction    = normalize(refract(ray.direction, invertedNormal, REFRACTION_ETA));
+
+	  intersection.type         = plane.specular.a > 0 ? REFLECTIVE : plane.albedo.a < 1.0f ? TRANSLUCENT : SOLID;
+	  intersection.albedo       = plane.albedo;
+	  intersection.specular     = plane.specular;
+      intersection.redf         = plane.redf;
+
+	  // world position projected on two axes of the plane.
+	  vec3 tangent              = normalize(cross(plane.normal.xyz, abs(plane.normal.y) < 0.9f ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+	  vec3 bitangent            = cross(plane.normal.xyz, tangent);
+	  intersection.texture      = plane.material.x;
+	  intersection.uv           = vec2(dot(intersection.point, tangent), dot(intersection.point, bitangent)) * MATERIAL_UV_SCALE;
+	  intersection.uvDensity    = MATERIAL_UV_SCALE;
+      return true;
+   }
+
+   return false;
+}
+
+/*
+var intersectCubeSource =
+' vec2 intersectCube(vec3 origin, vec3 ray, vec3 cubeMin, vec3 cubeMax) {' +
+'   vec3 tMin = (cubeMin - origin) / ray;' +
+'   vec3 tMax = (cubeMax - origin) / ray;' +
+'   vec3 t1 = min(tMin, tMax);' +
+'   vec3 t2 = max(tMin, tMax);' +
+'   float tNear = max(max(t1.x, t1.y), t1.z);' +
+'   float tFar = min(min(t2.x, t2.y), t2.z);' +
+'   return vec2(tNear, tFar);' +
+' }';
+*/
+
+//
+//
+//
+//
+
+// the lower half of the octahedron is folded over the upper one, see PackedScene::PackNormal().
+vec3 decodeOctahedral(uint packedNormal)
+{
+	vec2 e = unpackSnorm2x16(packedNormal);
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+void unpackMaterial(PackedMaterial packedMaterial, out vec4 albedo, out vec4 specular, out vec4 redf, out ivec4 material)
+{
+	albedo   = vec4(unpackHalf2x16(packedMaterial.colors.x), unpackHalf2x16(packedMaterial.colors.y));
+	specular = vec4(unpackHalf2x16(packedMaterial.colors.z), unpackHalf2x16(packedMaterial.colors.w));
+	redf     = unpackUnorm4x8(packedMaterial.factors);
+	material = ivec4(packedMaterial.texture, -1, -1, -1);
+}
+
+// plane p of the scene, from whichever copy the pipeline is specialized for.
+Plane scenePlane(int p)
+{
+	if (!PACKED_SCENE)
+		return _planes.planes[p];
+
+	Plane plane;
+	plane.position = vec4(_packedPlanes.planes[p].position, 1.0f);
+	plane.normal   = vec4(decodeOctahedral(_packedPlanes.planes[p].normal), 0.0f);
+	unpackMaterial(_packedPlanes.planes[p].material, plane.albedo, plane.specular, plane.redf, plane.material);
+	return plane;
+}
+
+Sphere sceneSphere(int s)
+{
+	if (!PACKED_SCENE)
+		return _spheres.spheres[s];
+
+	Sphere sphere;
+	sphere.position = _packedSpheres.spheres[s].position;
+	unpackMaterial(_packedSpheres.spheres[s].material, sphere.albedo, sphere.specular, sphere.redf, sphere.material);
+	return sphere;
+}
+
+// Intersects all the geometry in the scene.
+bool Intersect(Ray ray, Light light, out Intersection intersection)
+{
+    Intersection closestIntersection;
+    int intersectionCount = 0;
+
+	// intersect plane
+	for (int p = 0; p < PLANE_COUNT; p++)
+	{
+	    Plane plane = scenePlane(p);
+
+		Intersection ipp;
+		if ( intersectPlane(ray, plane, ipp) )
+		{
+			if (intersectionCount == 0)								closestIntersection = ipp;
+			else if (closestIntersection.range > ipp.range)			closestIntersection = ipp;
+
+            intersectionCount++;
+		}
+	}
+	
+    // intersect sphere.
+	for (int s = 0; s < SPHERE_COUNT; s++)
+	{
+	    Sphere sphere = sceneSphere(s);
+
+		Intersection ips;
+		if ( intersectSphere(ray, sphere, ips) )
+		{
+            if (intersectionCount == 0)								closestIntersection = ips;
+			else if (closestIntersection.range > ips.range)			closestIntersection = ips;
+
+            intersectionCount++;
+		}
+	}
+	
+    // return the data
+    intersection = closestIntersection;
+
+    if (intersectionCount > 0)
+    {
+        applyMaterialTexture(ray, intersection);
+        return true;
+    }
+    return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------- Material Functions ------------------------------------------------ //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+//
+//
+//
+//
+bool Reflection(Intersection intersection, Light light, vec3 pixelSeed, out Ray ray, out Intersection bounce)
+{
+    vec3 outputColor = vec3(0);
+
+	/*if (intersection.redf.r > 0.0f)
+		ray.direction    = normalize(intersection.reflection * (1.0f - intersection.redf.r) + normalize(CosineDirection(data.frame, -intersection.reflection, pixelSeed)) * intersection.redf.r );
+    else */ray.direction    = normalize(intersection.reflection);
+		
+	ray.origin       = intersection.point + ray.direction * BIAS;
+
+    bool occluded    = Intersect(ray, light, bounce);
+
+    return occluded;
+}
+
+
+//
+//
+//
+//
+bool Refraction(inout Ray ray, Intersection intersection, Light light, out Intersection refractedIntersection, vec3 pixelSeed)
+{
+    Intersection bounceIn;
+
+	vec3 invertedNormal = dot(ray.direction, intersection.normal) <= 0 ? intersection.normal : -intersection.normal;
+    ray.direction       = normalize(refract(ray.direction, invertedNormal, REFRACTION_ETA));
+	ray.origin          = intersection.point + ray.direction * BIAS;
+
+    bool occluded       = Intersect(ray, light, bounceIn);
+
+	refractedIntersection   = bounceIn;
+
+	return occluded;
+}
+
+
+//
+//
+//
+vec3 ShadowedLightning(Ray cameraRay, Ray ray, Intersection intersection, Light light, vec3 pixelSeed, float traveled, bool direct)
+{
+    vec3 outputColor = vec3(0);
+
+	// create occlusion ray
+    Intersection bounce;
+    Ray rayOcclusion;
+	rayOcclusion.direction    = -normalize(intersection.point + light.position);
+    rayOcclusion.origin       = intersection.point + rayOcclusion.direction * BIAS;
+
+    // travel through translucent nd reflective objects.
+	Intersection previous = intersection;
+	Ray previousOcclusion = ray;
+    bool occluded = Intersect(rayOcclusion, light, bounce);
+	int count = 0;
+	float refractionTraveled = 0;
+    while (occluded && count < MAX_BOUNCE_PER_TRACE && direct)
+	{
+		vec3 lastPoint = bounce.point;
+		if (length(previous.point + light.position) < bounce.range)
+		    break;
+
+		previousOcclusion = rayOcclusion;
+	    previous = bounce;
+
+	    /*if (bounce.type == REFLECTIVE)
+		{
+		    break;
+		    //occluded = Reflection(bounce, light, pixelSeed, rayOcclusion, bounce);
+			//vec3 currentPoint = bounce.point;
+		}
+		else */if (bounce.albedo.a < 1.0f)
+		{
+		    occluded = Refraction(rayOcclusion, bounce, light, bounce, pixelSeed) ;
+			vec3 currentPoint = bounce.point;
+		    refractionTraveled += length(lastPoint - currentPoint);
+		}
+		else
+		{
+		    break;
+		}    
+
+		count++;
+	}
+
+    // direct shadow
+    if (!occluded || length(previous.point + light.position) < bounce.range)
+	{
+	    float attenuation    = computeAttenuation(light, intersection.point, 0);
+
+        // diffuse
+	    outputColor      = computeDiffuse(intersection.point, intersection.normal, light) * intersection.albedo.rgb * attenuation;// * (!direct ? INDIRECT_DIFFUSE_INTENSITY : 1.0f);
+    
+		// speculr
+		if (count == 0 && direct)
+		{
+		    attenuation    = computeAttenuation(light, intersection.point, 0);
+		    outputColor    += clamp( computeSpecular(ray, light, intersection.point, intersection.normal, intersection.redf.r, 0.9f) * intersection.albedo.rgb * attenuation, 0.0f, 1.0f);
+		}
+		
+	    // refracted specular - CAUSTICS
+		if (count > 0 && CAUSTICS && direct)
+		{
+		     //float d        = clamp( dot(previousIntersection.normal, -previousOcclusion.direction), 0.0f, 1.0f );
+			 attenuation    = computeAttenuation(light, intersection.point, 0 + refractionTraveled);// * d;
+			 previousOcclusion.direction *= -1;
+		     outputColor     += computeSpecular(previousOcclusion, light, previous.point, previous.normal, previous.redf.r, 0.9f) * previous.albedo.rgb * attenuation;// * (!direct ? INDIRECT_CAUSTICS_INTENSITY : 1.0f), 0.0f, 16.0f);
+		}
+	}
+
+	// emission
+	if (bounce.redf.g > 0)
+		outputColor += bounce.redf.g * bounce.albedo.rgb;
+
+	return outputColor;
+}
+
+
+
+
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------------ Scene -------------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+// edge invocations must not write past the displayed image.
+void StoreResult(ivec2 uv, vec4 color)
+{
+    if (all(lessThan(uv, imageSize(resultImage))))
+	    imageStore(resultImage, uv, color);
+}
+
+Ray CameraRay(vec2 screenUV)
+{
+    // todo: use only 1 transform
+	vec3 nearPos        = screenToWorld( view.inverse_projection_view, vec3(screenUV, 0.0f) );
+	vec3 farPos         = screenToWorld( view.inverse_projection_view, vec3(screenUV, 1.0f) );
+
+	Ray ray;
+	ray.origin          = nearPos;
+	ray.direction       = normalize( farPos - nearPos );
+	return ray;
+}
+
+Light SceneLight()
+{
+	Light light;
+	light.type                  = _light.type;
+	light.position              = _light.position.xyz;
+	light.direction             = _light.direction.xyz;
+	light.color                 = _light.color.rgb;
+	light.constantAttenuation   = _light.constantAttenuation;
+	light.linearAttenuation     = _light.linearAttenuation;
+    light.quadraticAttenuation  = _light.quadraticAttenuation;
+	light.radius                = _light.radius;
+	return light;
+}
+
+// AA - subcell jitter of the sample being traced, -1 to 1 of half a pixel.
+vec2 PixelJitter(vec2 globalUV)
+{
+	float u = random(vec3(12.9898, 78.233, 151.7182), SAMPLE_INDEX, vec3(globalUV, 1)) * 2.0f - 1.0f;
+    float v = random(vec3(63.7264, 10.873, 623.6736), SAMPLE_INDEX, vec3(globalUV, 1)) * 2.0f - 1.0f;
+	return vec2(u, v);
+}
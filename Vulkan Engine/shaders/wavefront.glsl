@@ -0,0 +1,164 @@
+// shared by the wavefront_*.comp kernels. a path is one pixel of the paths in flight, its rays move
+// through storage buffer queues: raygen -> extend -> shade -> shadow -> extend ... -> resolve.
+
+// definitions, scene data, intersection and shading.
+#include "pathtracer.glsl"
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------------- DEFINITIONS -------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+#define         WAVEFRONT_GROUP_SIZE                     64                                             // same as PathTracer.cpp
+#define         RADIANCE_SCALE                           4096.0f                                        // fixed point radiance, summed with integer atomics
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------------- STRUCTS -------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+struct RayItem
+{
+	vec4  origin;
+	vec4  direction;
+	ivec4 info;                                                            // x = path, y = hit primitive, z = specular bounces, w = indirect ray, -1 on the specular chain
+};
+
+struct ShadowItem
+{
+	vec4  origin;                                                          // ray that hit the shaded surface
+	vec4  direction;                                                       // w = weight of the light sample
+	ivec4 info;                                                            // x = path, y = hit primitive, z = light sample, -1 is the undisplaced light, w = direct
+};
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------------ Queues ------------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+// two ray queues, extended and filled in turns by data.queue.
+layout(std430, binding = 8) buffer RayQueues
+{
+	RayItem items[];
+} _rays;
+
+// rays of the last extend that hit something.
+layout(std430, binding = 9) buffer HitQueue
+{
+	RayItem items[];
+} _hits;
+
+// first half one light sample per item, second half RAY_COUNT light samples per item.
+layout(std430, binding = 10) buffer ShadowQueue
+{
+	ShadowItem items[];
+} _shadows;
+
+// rgb per path.
+layout(std430, binding = 11) buffer Radiance
+{
+	uint channels[];
+} _radiance;
+
+// lengths and indirect dispatch sizes, same layout as PathTracer::Queues.
+layout(std430, binding = 12) buffer Queues
+{
+	uvec4 extend_dispatch;
+	uvec4 shade_dispatch;
+	uvec4 shadow_dispatch;
+	uint  ray_count[2];
+	uint  hit_count;
+	uint  shadow_count;
+	uint  light_count;
+} _queues;
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ------------------------------------------------------ Paths -------------------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+// paths in flight, the ray queue holds at most one ray per path.
+int PathCapacity()
+{
+	return _rays.items.length() / 2;
+}
+
+// paths of this pass, the last one of a sample may not fill the queues.
+int PathCount()
+{
+	int pixels = int(data.resolution.x) * int(data.resolution.y);
+	return min(PathCapacity(), pixels - data.path_offset);
+}
+
+ivec2 PathPixel(int path)
+{
+	int pixel = data.path_offset + path;
+	int width = int(data.resolution.x);
+	return ivec2(pixel % width, pixel / width);
+}
+
+// same seed the megakernel traces the pixel's sample with.
+vec3 PathSeed(int path)
+{
+	vec2 globalUV = (PathPixel(path) + view.tile_offset) / view.image_resolution;
+	return vec3(globalUV + PixelJitter(globalUV) / view.image_resolution / 2.0f, 1);
+}
+
+void AddRadiance(int path, vec3 color)
+{
+	uvec3 fixedColor = uvec3(max(vec3(0), color) * RADIANCE_SCALE + 0.5f);
+	atomicAdd(_radiance.channels[path * 3 + 0], fixedColor.r);
+	atomicAdd(_radiance.channels[path * 3 + 1], fixedColor.g);
+	atomicAdd(_radiance.channels[path * 3 + 2], fixedColor.b);
+}
+
+// --------------------------------------------------------------------------------------------------------------------- //
+// ---------------------------------------------------- Geometry Functions --------------------------------------------- //
+// --------------------------------------------------------------------------------------------------------------------- //
+
+// Closest hit of all the geometry in the scene, planes first then spheres. -1 when nothing is hit.
+int ClosestPrimitive(Ray ray)
+{
+	int   closest = -1;
+	float range   = 0.0f;
+
+	for (int p = 0; p < PLANE_COUNT; p++)
+	{
+		Intersection hit;
+		if (intersectPlane(ray, scenePlane(p), hit) && (closest < 0 || hit.range < range))
+		{
+			closest = p;
+			range   = hit.range;
+		}
+	}
+
+	for (int s = 0; s < SPHERE_COUNT; s++)
+	{
+		Intersection hit;
+		if (intersectSphere(ray, sceneSphere(s), hit) && (closest < 0 || hit.range < range))
+		{
+			closest = PLANE_COUNT + s;
+			range   = hit.range;
+		}
+	}
+
+	return closest;
+}
+
+// Rebuilds the intersection of a ray with the primitive it is known to hit.
+Intersection Surface(Ray ray, int primitive)
+{
+	Intersection hit;
+	if (primitive < PLANE_COUNT)
+		intersectPlane(ray, scenePlane(primitive), hit);
+	else
+		intersectSphere(ray, sceneSphere(primitive - PLANE_COUNT), hit);
+	applyMaterialTexture(ray, hit);
+	return hit;
+}
+
+Ray ItemRay(vec4 origin, vec4 direction)
+{
+	Ray ray;
+	ray.origin      = origin.xyz;
+	ray.direction   = direction.xyz;
+	return ray;
+}
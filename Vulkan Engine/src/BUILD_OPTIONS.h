@@ -1,4 +1,13 @@
 #pragma once
 
 #define BUILD_ENABLE_VULKAN_DEBUG								1
-#define BUILD_ENABLE_VULKAN_RUNTIME_DEBUG						1
\ No newline at end of file
+#define BUILD_ENABLE_VULKAN_RUNTIME_DEBUG						1
+
+// frames the cpu may record ahead of the gpu, each one has its own fence, semaphores and uniforms.
+#define BUILD_FRAMES_IN_FLIGHT									2
+// paths in flight of one wavefront pass, larger images take several passes. sizes the ray and shadow queues.
+#define BUILD_WAVEFRONT_PATHS									(1 << 18)
+// material textures the shaders index with VK_EXT_descriptor_indexing, capped by the device limits.
+#define BUILD_BINDLESS_TEXTURES									4096
+// without it, a fixed array of this many textures the shaders loop over.
+#define BUILD_MATERIAL_TEXTURE_SLOTS							16
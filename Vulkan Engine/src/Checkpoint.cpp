@@ -0,0 +1,123 @@
+#include "Checkpoint.h"
+
+#include <iostream>
+#include <cstring>
+
+static const char CHECKPOINT_MAGIC[8] = { 'A', 'V', 'K', 'C', 'K', 'P', 'T', 0 };
+
+Checkpoint::Checkpoint( std::string file_name )
+{
+	_file = CreateFileA( file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( _file == INVALID_HANDLE_VALUE ) {
+		std::cout << "Could not open checkpoint \"" << file_name << "\"!" << std::endl;
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( _file, &size ) || (uint64_t)size.QuadPart < sizeof(Header) ) {
+		std::cout << "Checkpoint \"" << file_name << "\" is truncated!" << std::endl;
+		return;
+	}
+	_size = (uint64_t)size.QuadPart;
+
+	_mapping = CreateFileMappingA( _file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( _mapping == NULL ) {
+		std::cout << "Could not map checkpoint \"" << file_name << "\"!" << std::endl;
+		return;
+	}
+
+	_data = reinterpret_cast<const uint8_t*>( MapViewOfFile( _mapping, FILE_MAP_READ, 0, 0, 0 ) );
+}
+
+Checkpoint::~Checkpoint()
+{
+	if ( _data != nullptr )						UnmapViewOfFile( _data );
+	if ( _mapping != NULL )						CloseHandle( _mapping );
+	if ( _file != INVALID_HANDLE_VALUE )		CloseHandle( _file );
+}
+
+
+bool Checkpoint::IsValid()
+{
+	if ( _data == nullptr )
+		return false;
+
+	const Header * header = GetHeader();
+	if ( memcmp( header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) ) != 0 || header->version != VERSION )
+		return false;
+
+	return _size >= sizeof(Header) + GetPixelSize();
+}
+
+const Checkpoint::Header * Checkpoint::GetHeader()
+{
+	return reinterpret_cast<const Header*>( _data );
+}
+
+const void * Checkpoint::GetPixels()
+{
+	return _data + sizeof(Header);
+}
+
+uint64_t Checkpoint::GetPixelSize()
+{
+	return (uint64_t)GetHeader()->width * GetHeader()->height * 4 * sizeof(float);
+}
+
+
+bool Checkpoint::Exists( std::string file_name )
+{
+	return GetFileAttributesA( file_name.c_str() ) != INVALID_FILE_ATTRIBUTES;
+}
+
+bool Checkpoint::Write( std::string file_name, const Header & header, const void * pixels )
+{
+	std::string temp_file_name = file_name + ".tmp";
+
+	HANDLE file = CreateFileA( temp_file_name.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		std::cout << "Could not open \"" << temp_file_name << "\" for writing!" << std::endl;
+		return false;
+	}
+
+	Header stamped = header;
+	memcpy( stamped.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) );
+	stamped.version = VERSION;
+
+	DWORD	written		= 0;
+	bool	success		= WriteFile( file, &stamped, sizeof(Header), &written, nullptr ) && written == sizeof(Header);
+
+	// WriteFile takes 32 bit sizes, large images go in chunks.
+	const uint8_t *	source		= reinterpret_cast<const uint8_t*>( pixels );
+	uint64_t		remaining	= (uint64_t)header.width * header.height * 4 * sizeof(float);
+	while ( success && remaining > 0 )
+	{
+		DWORD chunk = (DWORD)( remaining < ( 1u << 30 ) ? remaining : ( 1u << 30 ) );
+		success		= WriteFile( file, source, chunk, &written, nullptr ) && written == chunk;
+		source		+= chunk;
+		remaining	-= chunk;
+	}
+
+	success = success && FlushFileBuffers( file );
+	CloseHandle( file );
+
+	// the old checkpoint stays intact until the new one is fully on disk.
+	success = success && MoveFileExA( temp_file_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+
+	if ( !success )
+		std::cout << "Could not write checkpoint \"" << file_name << "\"!" << std::endl;
+
+	return success;
+}
+
+// FNV-1a, chained through the hash parameter.
+uint64_t Checkpoint::Hash( const void * data, size_t size, uint64_t hash )
+{
+	const uint8_t * bytes = reinterpret_cast<const uint8_t*>( data );
+	for ( size_t i = 0; i < size; i++ )
+	{
+		hash ^= bytes[ i ];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
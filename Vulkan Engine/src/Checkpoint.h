@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#include "Platform.h"
+
+// Accumulation state on disk: header followed by width * height rgba32f texels ( rgb = mean color, a = sample count ).
+// Written to a temporary file and renamed, so a killed process never leaves a torn checkpoint behind.
+// Opened checkpoints are memory mapped, the texels are uploaded straight from the mapping.
+class Checkpoint
+{
+	public:
+		static const uint32_t				VERSION					= 1;
+
+		struct Header
+		{
+			char							magic[8];
+			uint32_t						version;
+			uint32_t						width;
+			uint32_t						height;
+			uint32_t						frame;					// sample index of the last accumulated frame
+			float							time;
+			uint32_t						sample_offset;			// first sample index, the file holds frame + 1 samples from here
+			uint64_t						scene_hash;
+			float							view[16];				// camera view matrix
+		};
+
+	private:
+		HANDLE								_file					= INVALID_HANDLE_VALUE;
+		HANDLE								_mapping				= NULL;
+		const uint8_t			*			_data					= nullptr;
+		uint64_t							_size					= 0;
+
+	public:
+		Checkpoint( std::string file_name );
+		~Checkpoint();
+
+		bool								IsValid();
+		const Header			*			GetHeader();
+		const void				*			GetPixels();
+		uint64_t							GetPixelSize();
+
+		static bool							Exists( std::string file_name );
+		static bool							Write( std::string file_name, const Header & header, const void * pixels );
+		static uint64_t						Hash( const void * data, size_t size, uint64_t hash = 14695981039346656037ULL );
+};
@@ -0,0 +1,308 @@
+#include "Distributed.h"
+#include "Checkpoint.h"
+#include "ImageFile.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+// options of the parent that every worker gets its own value of, and how many values follow them.
+struct WorkerOption
+{
+	const char *	name;
+	int				value_count;
+};
+
+static const WorkerOption worker_options[] =
+{
+	{ "o", 1 }, { "output", 1 }, { "spp", 1 }, { "checkpoint", 1 }, { "checkpoint-interval", 1 }, { "size", 2 },
+	{ "resolution", 2 }, { "jobs", 1 }, { "gpus", 1 }, { "gpu", 1 }, { "sample-offset", 1 }, { "tile-worker", 2 },
+};
+
+
+std::vector<Distributed::Unit> Distributed::Split( uint32_t samples, uint32_t sample_offset, uint32_t worker_count )
+{
+	std::vector<Unit> units;
+
+	// never more workers than samples, the remainder goes to the first ones.
+	worker_count = worker_count < samples ? worker_count : samples;
+	for ( uint32_t i = 0; i < worker_count; i++ )
+	{
+		Unit unit;
+		unit.samples		= samples / worker_count + ( i < samples % worker_count ? 1 : 0 );
+		unit.sample_offset	= sample_offset;
+		sample_offset		+= unit.samples;
+
+		units.push_back( unit );
+	}
+
+	return units;
+}
+
+std::string Distributed::PartialName( std::string output_file, uint32_t index )
+{
+	return output_file + ".part" + std::to_string( index ) + ".ckpt";
+}
+
+
+// one argument as CommandLineToArgvW reads it back: quotes are escaped, backslashes only doubled where a quote follows.
+static std::string Quote( const std::string & argument )
+{
+	std::string	quoted		= "\"";
+	size_t		backslashes	= 0;
+	for ( char c : argument )
+	{
+		if ( c == '\\' ) {
+			backslashes++;
+			continue;
+		}
+
+		quoted.append( c == '"' ? backslashes * 2 + 1 : backslashes, '\\' );
+		quoted		+= c;
+		backslashes	= 0;
+	}
+
+	// trailing backslashes are doubled too, the closing quote follows them.
+	quoted.append( backslashes * 2, '\\' );
+	return quoted + "\"";
+}
+
+// new options reach the workers without being listed here, only the ones Run() and RunTiles() replace are dropped.
+std::vector<std::string> Distributed::WorkerArguments( int argc, char ** argv )
+{
+	std::vector<std::string> arguments;
+	for ( int i = 1; i < argc; i++ )
+	{
+		// -name and --name are the same option.
+		std::string arg		= argv[ i ];
+		std::string name	= arg.compare( 0, 2, "--" ) == 0 ? arg.substr( 2 ) : arg.compare( 0, 1, "-" ) == 0 ? arg.substr( 1 ) : "";
+
+		int skip = -1;
+		for ( const WorkerOption & option : worker_options )
+		{
+			if ( name == option.name )
+				skip = option.value_count;
+		}
+
+		if ( skip < 0 )	arguments.push_back( arg );
+		else			i += skip;
+	}
+	return arguments;
+}
+
+// the options Run() and RunTiles() set per worker, followed by the forwarded ones.
+static std::string WorkerCommand( std::string output_file, uint32_t width, uint32_t height, uint32_t sample_offset, uint32_t samples, uint32_t gpu, const std::vector<std::string> & arguments )
+{
+	char executable[ MAX_PATH ];
+	GetModuleFileNameA( nullptr, executable, MAX_PATH );
+
+	std::string command = Quote( executable ) +
+						  " -o " + Quote( output_file ) +
+						  " -resolution " + std::to_string( width ) + " " + std::to_string( height ) +
+						  " -sample-offset " + std::to_string( sample_offset ) +
+						  " -spp " + std::to_string( samples ) +
+						  " -gpu " + std::to_string( gpu );
+	for ( const std::string & argument : arguments )
+		command += " " + Quote( argument );
+
+	return command;
+}
+
+// starts every worker and waits for all of them, true only when each one got to the end.
+static bool LaunchWorkers( const std::vector<std::string> & commands, const std::vector<std::string> & descriptions )
+{
+	std::vector<PROCESS_INFORMATION> processes;
+
+	std::cout << "-------------------------------------- Launching " << commands.size() << " workers -----------------------------------" << std::endl;
+
+	for ( uint32_t i = 0; i < (uint32_t)commands.size(); i++ )
+	{
+		STARTUPINFOA		startup_info	= {};
+		PROCESS_INFORMATION	process			= {};
+		startup_info.cb = sizeof(startup_info);
+
+		// CreateProcess may modify the command line.
+		std::vector<char> command_line( commands[ i ].begin(), commands[ i ].end() );
+		command_line.push_back( 0 );
+
+		if ( !CreateProcessA( nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup_info, &process ) ) {
+			std::cout << "Could not launch worker: " << commands[ i ] << std::endl;
+			continue;
+		}
+
+		std::cout << " - Worker " << i << ": " << descriptions[ i ] << std::endl;
+
+		processes.push_back( process );
+	}
+
+	bool success = processes.size() == commands.size();
+	for ( PROCESS_INFORMATION & process : processes )
+	{
+		WaitForSingleObject( process.hProcess, INFINITE );
+
+		DWORD exit_code = 1;
+		GetExitCodeProcess( process.hProcess, &exit_code );
+		success = success && exit_code == 0;
+
+		CloseHandle( process.hThread );
+		CloseHandle( process.hProcess );
+	}
+
+	return success;
+}
+
+bool Distributed::Run( std::string output_file, uint32_t width, uint32_t height, uint32_t samples, uint32_t sample_offset, uint32_t worker_count, uint32_t gpu_count, const std::vector<std::string> & arguments )
+{
+	std::vector<Unit>			units		= Split( samples, sample_offset, worker_count );
+	std::vector<std::string>	commands;
+	std::vector<std::string>	descriptions;
+	std::vector<std::string>	partials;
+
+	for ( uint32_t i = 0; i < (uint32_t)units.size(); i++ )
+	{
+		std::string partial = PartialName( output_file, i );
+		commands.push_back( WorkerCommand( partial, width, height, units[ i ].sample_offset, units[ i ].samples, gpu_count > 0 ? i % gpu_count : 0, arguments ) );
+		descriptions.push_back( "samples " + std::to_string( units[ i ].sample_offset ) + " - " + std::to_string( units[ i ].sample_offset + units[ i ].samples ) );
+		partials.push_back( partial );
+	}
+
+	if ( !LaunchWorkers( commands, descriptions ) ) {
+		std::cout << "Not all workers finished, nothing merged." << std::endl;
+		return false;
+	}
+
+	return Merge( partials, output_file, sample_offset, samples );
+}
+
+bool Distributed::RunTiles( std::string output_file, uint32_t width, uint32_t height, uint32_t image_width, uint32_t image_height, uint32_t samples, uint32_t sample_offset, uint32_t worker_count, uint32_t gpu_count, const std::vector<std::string> & arguments )
+{
+	// laid out once here, the workers only fill in their tiles.
+	{
+		TileWriter writer( output_file, image_width, image_height );
+		if ( !writer.IsOpen() )
+			return false;
+	}
+
+	std::vector<std::string> commands;
+	std::vector<std::string> descriptions;
+
+	for ( uint32_t i = 0; i < worker_count; i++ )
+	{
+		commands.push_back( WorkerCommand( output_file, width, height, sample_offset, samples, gpu_count > 0 ? i % gpu_count : 0, arguments ) +
+							" -size " + std::to_string( image_width ) + " " + std::to_string( image_height ) +
+							" -tile-worker " + std::to_string( i ) + " " + std::to_string( worker_count ) );
+		descriptions.push_back( "tiles " + std::to_string( i ) + ", " + std::to_string( i + worker_count ) + ", ..." );
+	}
+
+	if ( !LaunchWorkers( commands, descriptions ) ) {
+		std::cout << "Not all workers finished, tiles of " << output_file << " are missing." << std::endl;
+		return false;
+	}
+
+	std::cout << "Rendered " << image_width << "x" << image_height << " with " << worker_count << " workers into " << output_file << std::endl;
+	return true;
+}
+
+
+bool Distributed::Merge( std::vector<std::string> partial_files, std::string output_file, uint32_t sample_offset, uint32_t samples )
+{
+	if ( partial_files.empty() )
+		return false;
+
+	// sample ranges first, nothing is accumulated from a set that draws samples twice or misses some.
+	std::vector<Unit> ranges;
+	for ( std::string & partial_file : partial_files )
+	{
+		Checkpoint partial( partial_file );
+		if ( !partial.IsValid() ) {
+			std::cout << "Partial \"" << partial_file << "\" is not valid!" << std::endl;
+			return false;
+		}
+
+		const Checkpoint::Header * header = partial.GetHeader();
+		ranges.push_back( { header->sample_offset, header->frame + 1 } );
+	}
+
+	std::sort( ranges.begin(), ranges.end(), []( const Unit & a, const Unit & b ) { return a.sample_offset < b.sample_offset; } );
+	for ( size_t i = 1; i < ranges.size(); i++ )
+	{
+		uint32_t end = ranges[ i - 1 ].sample_offset + ranges[ i - 1 ].samples;
+		if ( ranges[ i ].sample_offset != end ) {
+			std::cout << "Partials " << ( ranges[ i ].sample_offset < end ? "overlap" : "miss samples" ) << " between sample " << end << " and " << ranges[ i ].sample_offset << "!" << std::endl;
+			return false;
+		}
+	}
+
+	uint32_t first	= ranges.front().sample_offset;
+	uint32_t last	= ranges.back().sample_offset + ranges.back().samples;
+	if ( samples > 0 && ( first != sample_offset || last != sample_offset + samples ) ) {
+		std::cout << "Partials cover samples " << first << " - " << last << ", expected " << sample_offset << " - " << sample_offset + samples << "!" << std::endl;
+		return false;
+	}
+
+	std::vector<float>	merged;
+	Checkpoint::Header	merged_header	= {};
+	uint32_t			frames			= 0;
+
+	for ( std::string & partial_file : partial_files )
+	{
+		Checkpoint partial( partial_file );
+		if ( !partial.IsValid() ) {
+			std::cout << "Partial \"" << partial_file << "\" is not valid!" << std::endl;
+			return false;
+		}
+
+		const Checkpoint::Header * header = partial.GetHeader();
+		if ( merged.empty() )
+		{
+			merged_header = *header;
+			merged.resize( (size_t)header->width * header->height * 4, 0.0f );
+		}
+		else if ( header->width != merged_header.width || header->height != merged_header.height || header->scene_hash != merged_header.scene_hash ||
+				  memcmp( header->view, merged_header.view, sizeof(header->view) ) != 0 )
+		{
+			std::cout << "Partial \"" << partial_file << "\" belongs to a different scene, resolution or view!" << std::endl;
+			return false;
+		}
+
+		// sum of color * count and of counts, divided once everything is in.
+		const float * pixels = reinterpret_cast<const float*>( partial.GetPixels() );
+		for ( size_t i = 0; i < merged.size(); i += 4 )
+		{
+			const float count = pixels[ i + 3 ];
+			merged[ i + 0 ] += pixels[ i + 0 ] * count;
+			merged[ i + 1 ] += pixels[ i + 1 ] * count;
+			merged[ i + 2 ] += pixels[ i + 2 ] * count;
+			merged[ i + 3 ] += count;
+		}
+
+		frames += header->frame + 1;
+	}
+
+	for ( size_t i = 0; i < merged.size(); i += 4 )
+	{
+		if ( merged[ i + 3 ] <= 0.0f )
+			continue;
+
+		merged[ i + 0 ] /= merged[ i + 3 ];
+		merged[ i + 1 ] /= merged[ i + 3 ];
+		merged[ i + 2 ] /= merged[ i + 3 ];
+	}
+
+	bool success;
+	if ( ImageFile::GetExtension( output_file ) == "ckpt" )
+	{
+		merged_header.frame			= frames - 1;
+		merged_header.sample_offset	= first;
+		success = Checkpoint::Write( output_file, merged_header, merged.data() );
+	}
+	else
+	{
+		success = ImageFile::Write( output_file, merged.data(), merged_header.width, merged_header.height );
+	}
+
+	if ( success )
+		std::cout << "Merged " << partial_files.size() << " partials ( " << frames << " samples ) into " << output_file << std::endl;
+
+	return success;
+}
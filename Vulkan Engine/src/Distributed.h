@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Platform.h"
+
+// Splits one render into sample ranges rendered by separate worker processes of this executable.
+// Workers write their accumulation as a checkpoint ( alpha = sample count ), the merge weights every partial by its counts.
+// Tiled renders split their tiles instead, the workers write into one output file laid out up front.
+// Partials only need a shared directory, so ranges can also be rendered on other machines and merged afterwards.
+class Distributed
+{
+	public:
+		struct Unit
+		{
+			uint32_t						sample_offset;
+			uint32_t						samples;
+		};
+
+	public:
+		static std::vector<Unit>			Split( uint32_t samples, uint32_t sample_offset, uint32_t worker_count );
+		static std::string					PartialName( std::string output_file, uint32_t index );
+
+		// the command line without the options Run() and RunTiles() set per worker, everything else renders the same scene in every worker.
+		static std::vector<std::string>		WorkerArguments( int argc, char ** argv );
+
+		// launches the workers, waits for all of them and merges their partials into output_file.
+		static bool							Run( std::string output_file, uint32_t width, uint32_t height, uint32_t samples, uint32_t sample_offset, uint32_t worker_count, uint32_t gpu_count, const std::vector<std::string> & arguments );
+
+		// launches workers for a tiled render and waits for them, each writes an interleaved share of the tiles straight into output_file.
+		static bool							RunTiles( std::string output_file, uint32_t width, uint32_t height, uint32_t image_width, uint32_t image_height, uint32_t samples, uint32_t sample_offset, uint32_t worker_count, uint32_t gpu_count, const std::vector<std::string> & arguments );
+
+		// output is an image ( .pfm, .exr, .png ) or another checkpoint ( .ckpt ) for merging further.
+		// the partial sample ranges have to line up without gaps or overlaps, and cover [ sample_offset, sample_offset + samples ) when samples is given.
+		static bool							Merge( std::vector<std::string> partial_files, std::string output_file, uint32_t sample_offset = 0, uint32_t samples = 0 );
+};
@@ -0,0 +1,295 @@
+#include "ImageFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb-master\stb-master\stb_image_write.h>
+
+
+std::string ImageFile::GetExtension( std::string file_name )
+{
+	size_t dot = file_name.find_last_of( '.' );
+	if ( dot == std::string::npos )
+		return "";
+
+	std::string extension = file_name.substr( dot + 1 );
+	std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower );
+	return extension;
+}
+
+bool ImageFile::Write( std::string file_name, const float * rgba, uint32_t width, uint32_t height )
+{
+	std::string extension = GetExtension( file_name );
+
+	if		( extension == "pfm" )		return WritePFM( file_name, rgba, width, height );
+	else if ( extension == "exr" )		return WriteEXR( file_name, rgba, width, height );
+	else if ( extension == "png" )		return WritePNG( file_name, rgba, width, height );
+
+	std::cout << "Unsupported image format: " << file_name << std::endl;
+	return false;
+}
+
+
+// portable float map, rgb, rows stored bottom to top, negative scale = little endian.
+bool ImageFile::WritePFM( std::string file_name, const float * rgba, uint32_t width, uint32_t height )
+{
+	std::ofstream file( file_name, std::ios::binary );
+	if ( file.fail() ) {
+		std::cout << "Could not open \"" << file_name << "\" for writing!" << std::endl;
+		return false;
+	}
+
+	file << PFMHeader( width, height );
+
+	std::vector<float> row( width * 3 );
+	for ( uint32_t y = 0; y < height; y++ )
+	{
+		const float * source = rgba + (size_t)( height - 1 - y ) * width * 4;
+		for ( uint32_t x = 0; x < width; x++ )
+		{
+			row[ x * 3 + 0 ] = source[ x * 4 + 0 ];
+			row[ x * 3 + 1 ] = source[ x * 4 + 1 ];
+			row[ x * 3 + 2 ] = source[ x * 4 + 2 ];
+		}
+		file.write( reinterpret_cast<const char*>( row.data() ), row.size() * sizeof(float) );
+	}
+
+	return !file.fail();
+}
+
+
+std::string ImageFile::PFMHeader( uint32_t width, uint32_t height )
+{
+	return "PF\n" + std::to_string( width ) + " " + std::to_string( height ) + "\n-1.0\n";
+}
+
+
+// minimal uncompressed scanline OpenEXR, 32 bit float B, G, R channels ( sorted by name as the spec requires ).
+static void _WriteEXRAttribute( std::ostream & file, const char * name, const char * type, const void * data, int32_t size )
+{
+	file.write( name, strlen( name ) + 1 );
+	file.write( type, strlen( type ) + 1 );
+	file.write( reinterpret_cast<const char*>( &size ), sizeof(int32_t) );
+	file.write( reinterpret_cast<const char*>( data ), size );
+}
+
+// writes everything up to the first scanline, returns where the scanlines start.
+uint64_t ImageFile::WriteEXRHeader( std::ostream & file, uint32_t width, uint32_t height )
+{
+	const int32_t	magic			= 20000630;
+	const int32_t	version			= 2;
+	file.write( reinterpret_cast<const char*>( &magic ), sizeof(int32_t) );
+	file.write( reinterpret_cast<const char*>( &version ), sizeof(int32_t) );
+
+	// channel list: name, pixel type ( 2 = float ), linear, reserved, x sampling, y sampling.
+	std::vector<char> channels;
+	const char * channel_names[] = { "B", "G", "R" };
+	for ( const char * channel_name : channel_names )
+	{
+		int32_t		pixel_type		= 2;
+		uint8_t		linear[4]		= { 0, 0, 0, 0 };
+		int32_t		sampling[2]		= { 1, 1 };
+
+		channels.insert( channels.end(), channel_name, channel_name + 2 );
+		channels.insert( channels.end(), reinterpret_cast<char*>( &pixel_type ), reinterpret_cast<char*>( &pixel_type ) + sizeof(int32_t) );
+		channels.insert( channels.end(), reinterpret_cast<char*>( linear ), reinterpret_cast<char*>( linear ) + sizeof(linear) );
+		channels.insert( channels.end(), reinterpret_cast<char*>( sampling ), reinterpret_cast<char*>( sampling ) + sizeof(sampling) );
+	}
+	channels.push_back( 0 );
+
+	uint8_t		compression			= 0;
+	int32_t		window[4]			= { 0, 0, (int32_t)width - 1, (int32_t)height - 1 };
+	uint8_t		line_order			= 0;
+	float		aspect_ratio		= 1.0f;
+	float		window_center[2]	= { 0.0f, 0.0f };
+	float		window_width		= 1.0f;
+
+	_WriteEXRAttribute( file, "channels",			"chlist",		channels.data(),	(int32_t)channels.size() );
+	_WriteEXRAttribute( file, "compression",		"compression",	&compression,		sizeof(compression) );
+	_WriteEXRAttribute( file, "dataWindow",			"box2i",		window,				sizeof(window) );
+	_WriteEXRAttribute( file, "displayWindow",		"box2i",		window,				sizeof(window) );
+	_WriteEXRAttribute( file, "lineOrder",			"lineOrder",	&line_order,		sizeof(line_order) );
+	_WriteEXRAttribute( file, "pixelAspectRatio",	"float",		&aspect_ratio,		sizeof(aspect_ratio) );
+	_WriteEXRAttribute( file, "screenWindowCenter",	"v2f",			window_center,		sizeof(window_center) );
+	_WriteEXRAttribute( file, "screenWindowWidth",	"float",		&window_width,		sizeof(window_width) );
+	file.put( 0 );
+
+	// line offset table, one uncompressed scanline per block.
+	const uint64_t	line_size		= (uint64_t)width * 3 * sizeof(float);
+	const uint64_t	data_offset		= (uint64_t)file.tellp() + (uint64_t)height * sizeof(uint64_t);
+	uint64_t		offset			= data_offset;
+	for ( uint32_t y = 0; y < height; y++ )
+	{
+		file.write( reinterpret_cast<const char*>( &offset ), sizeof(uint64_t) );
+		offset += sizeof(int32_t) * 2 + line_size;
+	}
+
+	return data_offset;
+}
+
+bool ImageFile::WriteEXR( std::string file_name, const float * rgba, uint32_t width, uint32_t height )
+{
+	std::ofstream file( file_name, std::ios::binary );
+	if ( file.fail() ) {
+		std::cout << "Could not open \"" << file_name << "\" for writing!" << std::endl;
+		return false;
+	}
+
+	WriteEXRHeader( file, width, height );
+
+	const int32_t	line_size		= (int32_t)( width * 3 * sizeof(float) );
+	std::vector<float> line( width * 3 );
+	for ( uint32_t y = 0; y < height; y++ )
+	{
+		const float * source = rgba + (size_t)y * width * 4;
+		for ( uint32_t x = 0; x < width; x++ )
+		{
+			line[ width * 0 + x ] = source[ x * 4 + 2 ];
+			line[ width * 1 + x ] = source[ x * 4 + 1 ];
+			line[ width * 2 + x ] = source[ x * 4 + 0 ];
+		}
+
+		int32_t line_y = (int32_t)y;
+		file.write( reinterpret_cast<const char*>( &line_y ), sizeof(int32_t) );
+		file.write( reinterpret_cast<const char*>( &line_size ), sizeof(int32_t) );
+		file.write( reinterpret_cast<const char*>( line.data() ), line_size );
+	}
+
+	return !file.fail();
+}
+
+
+// 8 bit png, values are clamped the same way the swapchain shows them.
+bool ImageFile::WritePNG( std::string file_name, const float * rgba, uint32_t width, uint32_t height )
+{
+	std::vector<unsigned char> pixels( (size_t)width * height * 4 );
+	for ( size_t i = 0; i < pixels.size(); i++ )
+	{
+		float value = ( i % 4 == 3 ) ? 1.0f : rgba[ i ];
+		pixels[ i ] = (unsigned char)( std::min( std::max( value, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+	}
+
+	if ( stbi_write_png( file_name.c_str(), width, height, 4, pixels.data(), width * 4 ) == 0 ) {
+		std::cout << "Could not write \"" << file_name << "\"!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+TileWriter::TileWriter( std::string file_name, uint32_t width, uint32_t height, bool create )
+{
+	_width		= width;
+	_height		= height;
+	_extension	= ImageFile::GetExtension( file_name );
+
+	if ( _extension != "pfm" && _extension != "exr" ) {
+		std::cout << "Tiled output needs a .pfm or .exr file: " << file_name << std::endl;
+		return;
+	}
+
+	_file.open( file_name, std::ios::in | std::ios::out | std::ios::binary | ( create ? std::ios::trunc : std::ios::openmode() ) );
+	if ( _file.fail() ) {
+		std::cout << "Could not open \"" << file_name << "\" for writing!" << std::endl;
+		return;
+	}
+
+	// headers are already in place, only their size is needed.
+	if ( !create )
+	{
+		std::ostringstream header;
+		_data_offset = _extension == "pfm" ? ImageFile::PFMHeader( width, height ).size() : ImageFile::WriteEXRHeader( header, width, height );
+		return;
+	}
+
+	uint64_t data_size;
+	if ( _extension == "pfm" )
+	{
+		std::string header	= ImageFile::PFMHeader( width, height );
+		_file.write( header.data(), header.size() );
+		_data_offset		= header.size();
+		data_size			= (uint64_t)width * height * 3 * sizeof(float);
+	}
+	else
+	{
+		_data_offset		= ImageFile::WriteEXRHeader( _file, width, height );
+		data_size			= (uint64_t)height * ( sizeof(int32_t) * 2 + (uint64_t)width * 3 * sizeof(float) );
+
+		// scanline block headers, the pixel data follows per tile.
+		const int32_t line_size = (int32_t)( width * 3 * sizeof(float) );
+		for ( uint32_t y = 0; y < height; y++ )
+		{
+			int32_t line_y = (int32_t)y;
+			_file.seekp( _data_offset + (uint64_t)y * ( sizeof(int32_t) * 2 + line_size ) );
+			_file.write( reinterpret_cast<const char*>( &line_y ), sizeof(int32_t) );
+			_file.write( reinterpret_cast<const char*>( &line_size ), sizeof(int32_t) );
+		}
+	}
+
+	// size the whole file up front, untouched areas read back as black.
+	_file.seekp( _data_offset + data_size - 1 );
+	_file.put( 0 );
+}
+
+TileWriter::~TileWriter()
+{
+	if ( _file.is_open() )
+		_file.close();
+}
+
+bool TileWriter::IsOpen()
+{
+	return _file.is_open() && !_file.fail();
+}
+
+bool TileWriter::Write( const float * rgba, uint32_t x, uint32_t y, uint32_t tile_width, uint32_t tile_height )
+{
+	if ( !IsOpen() || x >= _width || y >= _height )
+		return false;
+
+	const uint32_t		width		= std::min( tile_width, _width - x );
+	const uint32_t		height		= std::min( tile_height, _height - y );
+	std::vector<float>	row( width * 3 );
+
+	for ( uint32_t ty = 0; ty < height; ty++ )
+	{
+		const float *	source		= rgba + (size_t)ty * tile_width * 4;
+		const uint32_t	image_y		= y + ty;
+
+		if ( _extension == "pfm" )
+		{
+			for ( uint32_t tx = 0; tx < width; tx++ )
+			{
+				row[ tx * 3 + 0 ] = source[ tx * 4 + 0 ];
+				row[ tx * 3 + 1 ] = source[ tx * 4 + 1 ];
+				row[ tx * 3 + 2 ] = source[ tx * 4 + 2 ];
+			}
+
+			// pfm rows go bottom to top.
+			_file.seekp( _data_offset + ( (uint64_t)( _height - 1 - image_y ) * _width + x ) * 3 * sizeof(float) );
+			_file.write( reinterpret_cast<const char*>( row.data() ), width * 3 * sizeof(float) );
+		}
+		else
+		{
+			const uint64_t line_offset = _data_offset + (uint64_t)image_y * ( sizeof(int32_t) * 2 + (uint64_t)_width * 3 * sizeof(float) ) + sizeof(int32_t) * 2;
+
+			// exr lines are planar, B G R.
+			for ( uint32_t channel = 0; channel < 3; channel++ )
+			{
+				for ( uint32_t tx = 0; tx < width; tx++ )
+					row[ tx ] = source[ tx * 4 + 2 - channel ];
+
+				_file.seekp( line_offset + ( (uint64_t)channel * _width + x ) * sizeof(float) );
+				_file.write( reinterpret_cast<const char*>( row.data() ), width * sizeof(float) );
+			}
+		}
+	}
+
+	_file.flush();
+	return !_file.fail();
+}
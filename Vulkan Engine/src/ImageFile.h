@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+// Writes rgba float pixels ( top row first ) to disk.
+// Format is picked from the file extension: .pfm, .exr or .png
+class ImageFile
+{
+	public:
+		static bool							Write( std::string file_name, const float * rgba, uint32_t width, uint32_t height );
+
+		static bool							WritePFM( std::string file_name, const float * rgba, uint32_t width, uint32_t height );
+		static bool							WriteEXR( std::string file_name, const float * rgba, uint32_t width, uint32_t height );
+		static bool							WritePNG( std::string file_name, const float * rgba, uint32_t width, uint32_t height );
+
+		static std::string					GetExtension( std::string file_name );
+
+		static std::string					PFMHeader( uint32_t width, uint32_t height );
+		static uint64_t						WriteEXRHeader( std::ostream & file, uint32_t width, uint32_t height );
+};
+
+// Streams tiles of an image larger than memory into a .pfm or .exr file.
+// Both layouts are uncompressed with fixed offsets, so every tile row is written in place and only one tile is ever held.
+// Without create an existing file is opened as it was laid out, so several processes can write disjoint tiles into it.
+class TileWriter
+{
+	private:
+		std::fstream						_file;
+		std::string							_extension;
+		uint32_t							_width					= 0;
+		uint32_t							_height					= 0;
+		uint64_t							_data_offset			= 0;
+
+	public:
+		TileWriter( std::string file_name, uint32_t width, uint32_t height, bool create = true );
+		~TileWriter();
+
+		bool								IsOpen();
+
+		// rgba tile, top row first, cropped against the image edges.
+		bool								Write( const float * rgba, uint32_t x, uint32_t y, uint32_t tile_width, uint32_t tile_height );
+};
@@ -0,0 +1,222 @@
+#include "Ktx2.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+static const unsigned char ktx2_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// identifier, header, index.
+static const uint32_t ktx2_header_size		= 80;
+static const uint32_t ktx2_level_index_size	= 24;
+
+// khr data format descriptor color models.
+static const uint8_t khr_df_model_bc1a		= 128;
+static const uint8_t khr_df_model_bc5		= 132;
+static const uint8_t khr_df_model_bc7		= 134;
+
+template <typename T>
+static void Put( std::vector<unsigned char> & bytes, size_t offset, T value )
+{
+	memcpy( &bytes[offset], &value, sizeof(T) );
+}
+
+template <typename T>
+static T Get( const std::vector<unsigned char> & bytes, size_t offset )
+{
+	T value;
+	memcpy( &value, &bytes[offset], sizeof(T) );
+	return value;
+}
+
+// basic descriptor block, one sample per 64 bit channel of the block, bc7 has one 128 bit sample.
+static std::vector<unsigned char> DataFormatDescriptor( VkFormat format )
+{
+	uint8_t  model			= 0;
+	uint8_t  transfer		= 1;				// linear
+	uint32_t sample_count	= 1;
+	uint8_t  bit_length		= 63;
+
+	switch ( format )
+	{
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:		transfer = 2;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:		model = khr_df_model_bc1a;	break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:			model = khr_df_model_bc5;	sample_count = 2;	break;
+		case VK_FORMAT_BC7_SRGB_BLOCK:			transfer = 2;
+		case VK_FORMAT_BC7_UNORM_BLOCK:			model = khr_df_model_bc7;	bit_length = 127;	break;
+		default:								return std::vector<unsigned char>();
+	}
+
+	uint32_t block_size = 24 + 16 * sample_count;
+	std::vector<unsigned char> dfd( 4 + block_size, 0 );
+
+	Put<uint32_t>( dfd, 0, (uint32_t)dfd.size() );			// total size
+	Put<uint32_t>( dfd, 4, 0 );								// khronos, basic descriptor
+	Put<uint16_t>( dfd, 8, 2 );								// version 1.3
+	Put<uint16_t>( dfd, 10, (uint16_t)block_size );
+	dfd[12] = model;
+	dfd[13] = 1;											// bt709 primaries
+	dfd[14] = transfer;
+	dfd[15] = 0;											// straight alpha
+	dfd[16] = 3;											// 4x4 texel blocks, stored minus one
+	dfd[17] = 3;
+	dfd[20] = (uint8_t)Ktx2::GetBlockSize( format );		// bytes in plane 0
+
+	// bc5 has a red and a green channel, the others one channel covering the block.
+	for ( uint32_t i = 0; i < sample_count; i++ )
+	{
+		size_t sample = 28 + 16 * i;
+		Put<uint16_t>( dfd, sample, (uint16_t)( i * 64 ) );	// bit offset
+		dfd[sample + 2] = bit_length;
+		dfd[sample + 3] = (uint8_t)i;						// channel id
+		Put<uint32_t>( dfd, sample + 8, 0 );				// lower
+		Put<uint32_t>( dfd, sample + 12, 0xFFFFFFFF );		// upper
+	}
+
+	return dfd;
+}
+
+
+
+uint32_t Ktx2::GetBlockSize( VkFormat format )
+{
+	switch ( format )
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:			return 8;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:			return 16;
+		default:								return 0;
+	}
+}
+
+bool Ktx2::Read( std::string file_name, Image & image )
+{
+	std::ifstream file( file_name, std::ios::binary | std::ios::ate );
+	if ( file.fail() ) {
+		std::cout << "Could not open \"" << file_name << "\" file!" << std::endl;
+		return false;
+	}
+
+	size_t size = (size_t)file.tellg();
+	file.seekg( 0, std::ios::beg );
+
+	image.data.resize( size );
+	if ( size < ktx2_header_size || !file.read( reinterpret_cast<char*>( image.data.data() ), size ) || memcmp( image.data.data(), ktx2_identifier, sizeof(ktx2_identifier) ) != 0 ) {
+		std::cout << "\"" << file_name << "\" is not a KTX 2.0 file." << std::endl;
+		return false;
+	}
+
+	image.format				= (VkFormat)Get<uint32_t>( image.data, 12 );
+	image.width					= Get<uint32_t>( image.data, 20 );
+	image.height				= Get<uint32_t>( image.data, 24 );
+	uint32_t depth				= Get<uint32_t>( image.data, 28 );
+	uint32_t layer_count		= Get<uint32_t>( image.data, 32 );
+	uint32_t face_count			= Get<uint32_t>( image.data, 36 );
+	uint32_t level_count		= Get<uint32_t>( image.data, 40 );
+	uint32_t supercompression	= Get<uint32_t>( image.data, 44 );
+
+	// a level count of 0 asks for mips to be generated, the file still holds level 0.
+	level_count = level_count > 0 ? level_count : 1;
+
+	if ( image.format == VK_FORMAT_UNDEFINED || GetBlockSize( image.format ) == 0 || image.width == 0 || image.height == 0 ||
+		 depth > 0 || layer_count > 1 || face_count != 1 || supercompression != 0 || level_count > 32 ||
+		 ktx2_header_size + (size_t)level_count * ktx2_level_index_size > size ) {
+		std::cout << "\"" << file_name << "\" is not a supported KTX 2.0 texture, only block compressed 2d textures without supercompression are." << std::endl;
+		return false;
+	}
+
+	image.levels.resize( level_count );
+	for ( uint32_t i = 0; i < level_count; i++ )
+	{
+		size_t index = ktx2_header_size + i * ktx2_level_index_size;
+		image.levels[i].offset	= Get<uint64_t>( image.data, index );
+		image.levels[i].size	= Get<uint64_t>( image.data, index + 8 );
+
+		// compared without adding, offset + size can wrap.
+		if ( image.levels[i].offset > size || image.levels[i].size > size - image.levels[i].offset ) {
+			std::cout << "\"" << file_name << "\" is truncated." << std::endl;
+			return false;
+		}
+
+		// the copy into the image reads every block of the level.
+		uint64_t level_width	= image.width >> i > 0 ? image.width >> i : 1;
+		uint64_t level_height	= image.height >> i > 0 ? image.height >> i : 1;
+		uint64_t level_size		= ( ( level_width + 3 ) / 4 ) * ( ( level_height + 3 ) / 4 ) * GetBlockSize( image.format );
+		if ( image.levels[i].size < level_size ) {
+			std::cout << "\"" << file_name << "\" level " << i << " holds " << image.levels[i].size << " bytes, " << level_size << " are needed." << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// levels are stored smallest first, each aligned to its block size, the index lists them largest first.
+bool Ktx2::Write( std::string file_name, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>> & levels )
+{
+	std::vector<unsigned char> dfd = DataFormatDescriptor( format );
+	if ( dfd.empty() || levels.empty() ) {
+		std::cout << "Unsupported KTX 2.0 format " << format << "." << std::endl;
+		return false;
+	}
+
+	uint32_t level_count	= (uint32_t)levels.size();
+	uint32_t block_size		= GetBlockSize( format );
+	uint32_t dfd_offset		= ktx2_header_size + level_count * ktx2_level_index_size;
+
+	std::vector<uint64_t> offsets( level_count );
+	uint64_t end = dfd_offset + dfd.size();
+	for ( uint32_t i = level_count; i-- > 0; )
+	{
+		end			= ( end + block_size - 1 ) / block_size * block_size;
+		offsets[i]	= end;
+		end		   += levels[i].size();
+	}
+
+	std::vector<unsigned char> bytes( (size_t)end, 0 );
+	memcpy( &bytes[0], ktx2_identifier, sizeof(ktx2_identifier) );
+	Put<uint32_t>( bytes, 12, (uint32_t)format );
+	Put<uint32_t>( bytes, 16, 1 );							// type size of block compressed formats
+	Put<uint32_t>( bytes, 20, width );
+	Put<uint32_t>( bytes, 24, height );
+	Put<uint32_t>( bytes, 28, 0 );
+	Put<uint32_t>( bytes, 32, 0 );
+	Put<uint32_t>( bytes, 36, 1 );
+	Put<uint32_t>( bytes, 40, level_count );
+	Put<uint32_t>( bytes, 44, 0 );							// no supercompression
+	Put<uint32_t>( bytes, 48, dfd_offset );
+	Put<uint32_t>( bytes, 52, (uint32_t)dfd.size() );
+	// no key / value data, no supercompression data.
+
+	for ( uint32_t i = 0; i < level_count; i++ )
+	{
+		size_t index = ktx2_header_size + i * ktx2_level_index_size;
+		Put<uint64_t>( bytes, index, offsets[i] );
+		Put<uint64_t>( bytes, index + 8, levels[i].size() );
+		Put<uint64_t>( bytes, index + 16, levels[i].size() );
+		memcpy( &bytes[(size_t)offsets[i]], levels[i].data(), levels[i].size() );
+	}
+	memcpy( &bytes[dfd_offset], dfd.data(), dfd.size() );
+
+	std::ofstream file( file_name, std::ios::binary );
+	if ( file.fail() ) {
+		std::cout << "Could not open \"" << file_name << "\" for writing!" << std::endl;
+		return false;
+	}
+
+	file.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+	return !file.fail();
+}
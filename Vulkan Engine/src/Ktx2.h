@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Platform.h"
+
+// KTX 2.0 textures, the vulkan format and mip levels stored as they are uploaded.
+// Only 2d images without supercompression, which is what the converter writes.
+class Ktx2
+{
+	public:
+		struct Level
+		{
+			uint64_t						offset;					// into data
+			uint64_t						size;
+		};
+
+		struct Image
+		{
+			VkFormat						format					= VK_FORMAT_UNDEFINED;
+			uint32_t						width					= 0;
+			uint32_t						height					= 0;
+			std::vector<Level>				levels;					// level 0, the largest, first
+			std::vector<unsigned char>		data;
+		};
+
+	public:
+		static bool							Read( std::string file_name, Image & image );
+
+		// levels are the block compressed mips, largest first.
+		static bool							Write( std::string file_name, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>> & levels );
+
+		static uint32_t						GetBlockSize( VkFormat format );
+};
@@ -0,0 +1,98 @@
+#include "PackedScene.h"
+
+#include <cmath>
+#include <iostream>
+
+// one fp16 rounding step is 2^-11 of the value, unorm8 is half of 1 / 255.
+static const float fp16_tolerance	= 1.0f / 1024.0f;
+static const float unorm8_tolerance	= 0.5f / 255.0f + 1e-6f;
+
+// components of value that did not come back within tolerance, absolute or relative to the value.
+static bool CheckComponents( std::string name, const char * field, glm::vec4 value, glm::vec4 unpacked, float tolerance, bool relative )
+{
+	bool lossless = true;
+	for ( int c = 0; c < 4; c++ )
+	{
+		float allowed = relative ? std::abs( value[c] ) * tolerance + 1e-7f : tolerance;
+		if ( !( std::abs( unpacked[c] - value[c] ) <= allowed ) )
+		{
+			std::cout << "Packed scene: " << name << " " << field << "[" << c << "] " << value[c] << " is stored as " << unpacked[c] << "." << std::endl;
+			lossless = false;
+		}
+	}
+	return lossless;
+}
+
+// sign that is never 0, the octahedral fold needs a side for points on the axes.
+static glm::vec2 SignNotZero( glm::vec2 v )
+{
+	return glm::vec2( v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f );
+}
+
+
+
+PackedScene::Material PackedScene::PackMaterial( glm::vec4 albedo, glm::vec4 specular, glm::vec4 redf, int32_t texture )
+{
+	Material material = {};
+	material.colors.x	= glm::packHalf2x16( glm::vec2( albedo.r, albedo.g ) );
+	material.colors.y	= glm::packHalf2x16( glm::vec2( albedo.b, albedo.a ) );
+	material.colors.z	= glm::packHalf2x16( glm::vec2( specular.r, specular.g ) );
+	material.colors.w	= glm::packHalf2x16( glm::vec2( specular.b, specular.a ) );
+	material.factors	= glm::packUnorm4x8( redf );
+	material.texture	= texture;
+	return material;
+}
+
+void PackedScene::UnpackMaterial( const Material & material, glm::vec4 & albedo, glm::vec4 & specular, glm::vec4 & redf, int32_t & texture )
+{
+	albedo		= glm::vec4( glm::unpackHalf2x16( material.colors.x ), glm::unpackHalf2x16( material.colors.y ) );
+	specular	= glm::vec4( glm::unpackHalf2x16( material.colors.z ), glm::unpackHalf2x16( material.colors.w ) );
+	redf		= glm::unpackUnorm4x8( material.factors );
+	texture		= material.texture;
+}
+
+// the unit sphere projected on an octahedron, the lower half folded over the upper one.
+uint32_t PackedScene::PackNormal( glm::vec3 normal )
+{
+	glm::vec2 e = glm::vec2( normal.x, normal.y ) / ( std::abs( normal.x ) + std::abs( normal.y ) + std::abs( normal.z ) );
+	if ( normal.z < 0.0f )
+		e = ( 1.0f - glm::abs( glm::vec2( e.y, e.x ) ) ) * SignNotZero( e );
+	return glm::packSnorm2x16( e );
+}
+
+glm::vec3 PackedScene::UnpackNormal( uint32_t normal )
+{
+	glm::vec2 e = glm::unpackSnorm2x16( normal );
+	glm::vec3 n = glm::vec3( e.x, e.y, 1.0f - std::abs( e.x ) - std::abs( e.y ) );
+	if ( n.z < 0.0f )
+	{
+		glm::vec2 folded = ( 1.0f - glm::abs( glm::vec2( n.y, n.x ) ) ) * SignNotZero( glm::vec2( n.x, n.y ) );
+		n.x = folded.x;
+		n.y = folded.y;
+	}
+	return glm::normalize( n );
+}
+
+// factors outside 0..1 are clamped, emission above 1 loses its strength.
+bool PackedScene::CheckMaterial( std::string name, const Material & material, glm::vec4 albedo, glm::vec4 specular, glm::vec4 redf )
+{
+	glm::vec4	unpacked_albedo, unpacked_specular, unpacked_redf;
+	int32_t		texture;
+	UnpackMaterial( material, unpacked_albedo, unpacked_specular, unpacked_redf, texture );
+
+	bool lossless = CheckComponents( name, "albedo", albedo, unpacked_albedo, fp16_tolerance, true );
+	lossless = CheckComponents( name, "specular", specular, unpacked_specular, fp16_tolerance, true ) && lossless;
+	lossless = CheckComponents( name, "redf", redf, unpacked_redf, unorm8_tolerance, false ) && lossless;
+	return lossless;
+}
+
+// two snorm16 keep a normal within a few thousandths of a degree.
+bool PackedScene::CheckNormal( std::string name, uint32_t packed, glm::vec3 normal )
+{
+	glm::vec3 unpacked = UnpackNormal( packed );
+	if ( glm::dot( unpacked, glm::normalize( normal ) ) >= 0.99999f )
+		return true;
+
+	std::cout << "Packed scene: " << name << " normal ( " << normal.x << ", " << normal.y << ", " << normal.z << " ) is stored as ( " << unpacked.x << ", " << unpacked.y << ", " << unpacked.z << " )." << std::endl;
+	return false;
+}
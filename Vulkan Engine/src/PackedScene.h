@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <glm\glm.hpp>
+
+// Scene data at half the size, fp16 colors, unorm8 factors and octahedral normals.
+// pathtracer.glsl decodes the same std140 layout when the pipelines are specialized for it ( -packed-scene ).
+class PackedScene
+{
+	public:
+		struct Material
+		{
+			glm::uvec4						colors;					// albedo rg, albedo ba, specular rg, specular ba as fp16 pairs
+			uint32_t						factors;				// reflection, emission, decay, fresnel as unorm8, clamped to 0..1
+			int32_t							texture;				// albedo texture, -1 none
+			uint32_t						padding[2];
+		};
+
+		struct Plane
+		{
+			glm::vec3						position;
+			uint32_t						normal;					// octahedral, two snorm16
+			Material						material;
+		};
+
+		struct Sphere
+		{
+			glm::vec4						position;				// w = radius
+			Material						material;
+		};
+
+	public:
+		static Material						PackMaterial( glm::vec4 albedo, glm::vec4 specular, glm::vec4 redf, int32_t texture );
+		static void							UnpackMaterial( const Material & material, glm::vec4 & albedo, glm::vec4 & specular, glm::vec4 & redf, int32_t & texture );
+
+		static uint32_t						PackNormal( glm::vec3 normal );
+		static glm::vec3					UnpackNormal( uint32_t normal );
+
+		// decode what was packed and warn about every value that lost more than fp16 or unorm8 rounding, false if any did.
+		static bool							CheckMaterial( std::string name, const Material & material, glm::vec4 albedo, glm::vec4 specular, glm::vec4 redf );
+		static bool							CheckNormal( std::string name, uint32_t packed, glm::vec3 normal );
+};
+
+static_assert( sizeof(PackedScene::Plane) == 48 && sizeof(PackedScene::Sphere) == 48, "Packed primitives have to match their std140 size." );
@@ -1,10 +1,59 @@
 #include "PathTracer.h"
 #include <random>
+#include <cstring>
+#include <cstddef>
+
+// indexed by PathTracer::Quality.
+static const char * quality_names[] = { "draft", "medium", "high", "ultra" };
+static const PathTracer::QualityPreset quality_presets[] =
+{
+	//  frames, bounces, rays, caustics, bounces per trace, local size
+	{	500,	1,		1,		VK_FALSE,	2,		16, 16	},
+	{	1000,	2,		2,		VK_TRUE,	3,		16, 16	},
+	{	1000,	2,		4,		VK_TRUE,	5,		16, 16	},
+	{	4000,	2,		8,		VK_TRUE,	8,		8,  8	},
+};
+
+// constant ids of pathtracer.comp and the wavefront kernels, which ignore the local size.
+#define PRESET_OFFSET(member) offsetof(PathTracer::Specialization, preset) + offsetof(PathTracer::QualityPreset, member)
+static const VkSpecializationMapEntry specialization_map_entries[] =
+{
+	{ 0, PRESET_OFFSET(frame_count),									sizeof(int32_t) },
+	{ 1, PRESET_OFFSET(bounce_count),									sizeof(int32_t) },
+	{ 2, PRESET_OFFSET(ray_count),										sizeof(int32_t) },
+	{ 3, PRESET_OFFSET(caustics),										sizeof(VkBool32) },
+	{ 4, PRESET_OFFSET(max_bounce_per_trace),							sizeof(int32_t) },
+	{ 5, PRESET_OFFSET(local_size_x),									sizeof(uint32_t) },
+	{ 6, PRESET_OFFSET(local_size_y),									sizeof(uint32_t) },
+	{ 7, offsetof(PathTracer::Specialization, packed_scene),			sizeof(VkBool32) },
+};
+#undef PRESET_OFFSET
+
+// points at specialization, which has to outlive the pipeline creation.
+static VkSpecializationInfo PipelineSpecialization(const PathTracer::Specialization & specialization)
+{
+	VkSpecializationInfo specialization_info = {};
+	specialization_info.mapEntryCount	= sizeof(specialization_map_entries) / sizeof(specialization_map_entries[0]);
+	specialization_info.pMapEntries		= specialization_map_entries;
+	specialization_info.dataSize		= sizeof(PathTracer::Specialization);
+	specialization_info.pData			= &specialization;
+	return specialization_info;
+}
+
+// indexed by PathTracer::WavefrontKernel.
+static const char * wavefront_kernel_names[] = { "wavefront_raygen", "wavefront_extend", "wavefront_queues", "wavefront_shade", "wavefront_shadow", "wavefront_resolve" };
+
+// local size of the wavefront kernels, and the size of their RayItem and ShadowItem.
+static const uint32_t wavefront_group_size	= 64;
+static const uint32_t wavefront_item_size	= 48;
 
 // cons & dest
-PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
+PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height, bool packed_scene)
 {
 	_renderer									= renderer;
+	_width										= width;
+	_height										= height;
+	_packed_scene								= packed_scene;
 	
 	_camera										= new Camera( renderer->GetWindow(), glm::vec2( width, height ) );
 
@@ -12,8 +61,12 @@ PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
 
 	_uniform_general.time							    = 0.0f;
 	_uniform_general.resolution					        = glm::vec2(width, height);
-	_uniform_general.inverse_projection_view            = _camera->GetInverseProjectionView();
-	_uniform_general_buffer								= new DataBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_general, sizeof(General));
+	_uniform_view.image_resolution					    = glm::vec2(width, height);
+	_uniform_view.tile_offset						    = glm::vec2(0.0f);
+	_uniform_general.sample_offset				        = 0;
+	_uniform_general.preview_scale				        = 1;
+	_uniform_general.samples					        = 1;
+	_uniform_view.inverse_projection_view               = _camera->GetInverseProjectionView();
 
 	_uniform_light.type                                 = 0;
 	_uniform_light.position                             = glm::vec4(0.0f, 1.0f, 1.0f, 0);
@@ -23,15 +76,16 @@ PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
 	_uniform_light.constantAttenuation                  = 0.0f;
 	_uniform_light.linearAttenuation                    = 0.2f;
 	_uniform_light.quadraticAttenuation                 = 3.0f;
-	_uniform_light_buffer                               = new DataBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_light, sizeof(Light));
+	_uniform_light_buffer                               = new DeviceBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_light, sizeof(Light));
 
-	// green floor
+	// green floor, textured with the first material texture
 	Plane plane0;
 	plane0.position          = glm::vec4(0, -0.5, 0.0f, 1.0f);
 	plane0.normal            = glm::vec4(0, 1.0f, 0, 0.0f);
 	plane0.albedo            = glm::vec4(0.2f, 1.0f, 0.2f, 1.0f);
 	plane0.specular          = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 	plane0.redf              = glm::vec4(0.4f, 0.0f, 0.0, 0.025f);
+	plane0.material.x        = 0;
 	
 	// blue ceiling
 	Plane plane1;
@@ -72,6 +126,7 @@ PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
 	plane5.albedo            = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
 	plane5.specular          = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 	plane5.redf              = glm::vec4(0.99f, 0.0f, 0.0f, 0.025f);
+	plane5.material.x        = 1;
 
 	///////// SPHERES ////////////////
 
@@ -102,6 +157,7 @@ PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
 	sphere_3.albedo = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
 	sphere_3.specular = glm::vec4(3.0f, 3.0f, 3.0f, 0.0f);
 	sphere_3.redf = glm::vec4(0.2f, 0.0f, 0.0f, 0.025f);
+	sphere_3.material.x = 2;
 
 
 	_uniform_planes.planes[0] = plane0;
@@ -116,31 +172,171 @@ PathTracer::PathTracer(Renderer * renderer, uint32_t width, uint32_t height)
 	_uniform_spheres.spheres[2] = sphere_2;
 	_uniform_spheres.spheres[3] = sphere_3;
 
-	_uniform_planes_buffer                              = new DataBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_planes, sizeof(Planes));
-	_uniform_spheres_buffer                             = new DataBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_spheres, sizeof(Spheres));
+	_uniform_planes_buffer                              = new DeviceBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_planes, sizeof(Planes));
+	_uniform_spheres_buffer                             = new DeviceBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &_uniform_spheres, sizeof(Spheres));
 
+	// fp16 colors, unorm8 factors and octahedral normals, read instead by pipelines specialized for it.
+	PackedPlanes packed_planes = {};
+	for (uint32_t i = 0; i < sizeof(packed_planes.planes) / sizeof(packed_planes.planes[0]); i++)
+	{
+		const Plane & plane = _uniform_planes.planes[i];
+		packed_planes.planes[i].position	= glm::vec3(plane.position);
+		packed_planes.planes[i].normal		= PackedScene::PackNormal(glm::vec3(plane.normal));
+		packed_planes.planes[i].material	= PackedScene::PackMaterial(plane.albedo, plane.specular, plane.redf, plane.material.x);
+
+		PackedScene::CheckNormal("plane " + std::to_string(i), packed_planes.planes[i].normal, glm::vec3(plane.normal));
+		PackedScene::CheckMaterial("plane " + std::to_string(i), packed_planes.planes[i].material, plane.albedo, plane.specular, plane.redf);
+	}
+
+	PackedSpheres packed_spheres = {};
+	for (uint32_t i = 0; i < sizeof(packed_spheres.spheres) / sizeof(packed_spheres.spheres[0]); i++)
+	{
+		const Sphere & sphere = _uniform_spheres.spheres[i];
+		packed_spheres.spheres[i].position	= sphere.position;
+		packed_spheres.spheres[i].material	= PackedScene::PackMaterial(sphere.albedo, sphere.specular, sphere.redf, sphere.material.x);
+
+		PackedScene::CheckMaterial("sphere " + std::to_string(i), packed_spheres.spheres[i].material, sphere.albedo, sphere.specular, sphere.redf);
+	}
+
+	_packed_planes_buffer                               = new DeviceBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &packed_planes, sizeof(PackedPlanes));
+	_packed_spheres_buffer                              = new DeviceBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &packed_spheres, sizeof(PackedSpheres));
+
+	// pixel counter of the persistent threads, cleared by every dispatch that uses it.
+	uint32_t next_pixel                                 = 0;
+	_work_buffer                                        = new DeviceBuffer(renderer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &next_pixel, sizeof(uint32_t));
+
+	// room for a view per tile of a frame, once tiles get traced together.
+	_view_ring                                          = new RingBuffer(renderer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 4096, BUILD_FRAMES_IN_FLIGHT, sizeof(View));
+
+	// textures arrive over the next frames, the slots they go to show white until then.
+	_texture_streamer                                   = new TextureStreamer(renderer);
+	_bindless                                           = renderer->SupportsDescriptorIndexing();
+	_texture_slots                                      = _bindless ? renderer->GetMaxBindlessTextures() : BUILD_MATERIAL_TEXTURE_SLOTS;
+	_uniform_general.texture_count                      = 0;
 
 	std::cout << "-------------------------------------- Creating a compute shader pipeline -----------------------------------" << std::endl;
 
 	_CreateDescriptorSetLayouts();
 	_CreatePipelineLayout();
-	_CreateDescriptorPool();
-
-	_descriptor_sets.resize(2);
-	_AllocateDescriptorSets(); 
-
 	_CreatePipelineCache();
 	_CreatePipeline();
 
 	std::cout << "-------------------------------------- Creating compute buffers, pool, fence -----------------------------------" << std::endl;
 
 	_CreateCommandPoolAndBuffers();
-	_RecordCommandBuffers();
-	_CreateFence();
+	_CreateImages();
+	_CreateDescriptorPool();
+	_AllocateDescriptorSets();
+	_CreateSyncObjects();
+	_CreateQueryPool();
 }
 
+// waits for its own frames only, the device keeps running for whatever else uses it.
 PathTracer::~PathTracer()
 {
+	VkDevice device = _renderer->GetDevice();
+	vkWaitForFences(device, (uint32_t)_fences.size(), _fences.data(), VK_TRUE, UINT64_MAX);
+
+	// finishes pending image writes.
+	_DestroyImages();
+	delete _tile_writer;
+
+	// picks up pipelines compiled from rebuilt shaders.
+	_pipeline_cache->Save();
+	delete _pipeline_cache;
+
+	for (VkPipeline pipeline : _pipelines)
+		vkDestroyPipeline(device, pipeline, nullptr);
+	for (VkPipeline pipeline : _wavefront_pipelines)
+		vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipeline(device, _upsample_pipeline, nullptr);
+	vkDestroyPipelineLayout(device, _pipeline_layout, nullptr);
+
+	// destroying the pools frees their sets.
+	vkDestroyDescriptorPool(device, _descriptor_pool, nullptr);
+	vkDestroyDescriptorPool(device, _texture_descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, _descriptor_set_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, _texture_set_layout, nullptr);
+
+	delete _uniform_light_buffer;
+	delete _uniform_planes_buffer;
+	delete _uniform_spheres_buffer;
+	delete _packed_planes_buffer;
+	delete _packed_spheres_buffer;
+	delete _work_buffer;
+	delete _ray_queue_buffer;
+	delete _hit_queue_buffer;
+	delete _shadow_queue_buffer;
+	delete _radiance_buffer;
+	delete _queues_buffer;
+	delete _view_ring;
+
+	delete _texture_streamer;
+	for (Texture * texture : _textures)
+		delete texture;
+	delete _default_texture;
+
+	for (uint32_t i = 0; i < (uint32_t)_fences.size(); i++)
+	{
+		vkDestroyFence(device, _fences[i], nullptr);
+		vkDestroySemaphore(device, _semaphores_traced[i], nullptr);
+	}
+	vkDestroyQueryPool(device, _query_pool, nullptr);
+	vkDestroyCommandPool(device, _command_pool, nullptr);
+
+	delete _camera;
+
+	// every frame ends with one of the fences, so nothing queued for deletion is in use any more.
+	_renderer->GetDeletionQueue()->Flush();
+}
+
+
+// images, everything sized by the render resolution.
+void PathTracer::_CreateImages()
+{
+	// float accumulation, rgb = mean color, a = sample count.
+	_accumulation                                       = new Texture(_renderer, _width, _height, VK_FORMAT_R32G32B32A32_SFLOAT, 1, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                                                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	_readback                                           = new Readback(_renderer, _width, _height, sizeof(glm::vec4));
+
+	// preview color is sized for the smallest scale, larger scales use its top left part.
+	_preview                                            = new Texture(_renderer, (_width + 1) / 2, (_height + 1) / 2, VK_FORMAT_R32G32B32A32_SFLOAT, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_USAGE_STORAGE_BIT);
+	_guide                                              = new Texture(_renderer, _width, _height, VK_FORMAT_R32G32B32A32_SFLOAT, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_USAGE_STORAGE_BIT);
+
+	// displayed color, one per frame in flight so tracing never writes an image the blit still reads.
+	for (uint32_t i = 0; i < BUILD_FRAMES_IN_FLIGHT; i++)
+		_displays.push_back(new Texture(_renderer, _width, _height, VK_FORMAT_R8G8B8A8_UNORM, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true));
+
+	_ClearStorageImage(_accumulation);
+	_ClearStorageImage(_preview);
+	_ClearStorageImage(_guide);
+	for (Texture * display : _displays)
+		_ClearStorageImage(display);
+
+	// white, in every material texture slot that has nothing loaded yet. the resolution does not change it.
+	if (!_default_texture)
+	{
+		_default_texture = new Texture(_renderer, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, 1, VK_IMAGE_ASPECT_COLOR_BIT,
+									   VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		_ClearStorageImage(_default_texture, { { 1.0f, 1.0f, 1.0f, 1.0f } });
+	}
+}
+
+void PathTracer::_DestroyImages()
+{
+	// finishes pending image writes.
+	delete _readback;
+	delete _accumulation;
+	delete _preview;
+	delete _guide;
+	for (Texture * display : _displays)
+		delete display;
+	_displays.clear();
+
+	_readback		= nullptr;
+	_accumulation	= nullptr;
+	_preview		= nullptr;
+	_guide			= nullptr;
 }
 
 
@@ -149,198 +345,1033 @@ void PathTracer::_CreateDescriptorSetLayouts()
 {
 	std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = 
 	{ 
-		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
-		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 2),
 		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
 		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
-		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5)
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 7),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 10),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 11),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 12),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 13),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 14),
+		Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 15)
 	};
 
 	VkDescriptorSetLayoutCreateInfo create_info = Structs::DescriptorSetLayoutCreateInfo(set_layout_bindings);
 	ErrorCheck( vkCreateDescriptorSetLayout( _renderer->GetDevice(), &create_info, nullptr, &_descriptor_set_layout),
 											"Unable to crete descriptor set layout.", "Descriptor set layout created." );
+
+	// material textures, a set of their own since update after bind sets can not hold the dynamic view uniform.
+	VkDescriptorSetLayoutBinding texture_binding = Structs::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+	texture_binding.descriptorCount = _texture_slots;
+	std::vector<VkDescriptorSetLayoutBinding> texture_bindings = { texture_binding };
+
+	VkDescriptorSetLayoutCreateInfo texture_create_info = Structs::DescriptorSetLayoutCreateInfo(texture_bindings);
+
+#ifdef VK_EXT_descriptor_indexing
+	// bindless, slots past the ones handed out stay unwritten.
+	VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {};
+	binding_flags_info.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	binding_flags_info.bindingCount		= 1;
+	binding_flags_info.pBindingFlags	= &binding_flags;
+	if (_bindless)
+	{
+		texture_create_info.pNext = &binding_flags_info;
+		texture_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	}
+#endif
+
+	ErrorCheck( vkCreateDescriptorSetLayout( _renderer->GetDevice(), &texture_create_info, nullptr, &_texture_set_layout),
+											"Unable to crete material texture set layout.", "Material texture set layout created." );
 }
 
 void PathTracer::_CreateDescriptorPool()
 {
+	// one set per frame in flight.
+	uint32_t set_count = BUILD_FRAMES_IN_FLIGHT;
+
 	std::vector<VkDescriptorPoolSize> poolSizes =
 	{
 		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),			// required for uniforms dfq?
 		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2),					// uniforms
-		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),					// Compute pipelines uses a storage image for image reads and writes
-		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),					// uniforms
+		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4 * set_count),		// Compute pipelines uses a storage image for image reads and writes
+		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5 * set_count),		// uniforms, packed scene
+		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, set_count),	// view ring
+		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * set_count),		// wavefront queues, persistent threads counter
 	};
 
-	VkDescriptorPoolCreateInfo descriptorPoolInfo = Structs::DescriptorPoolCreateInfo(poolSizes);
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = Structs::DescriptorPoolCreateInfo(poolSizes, set_count);
 	ErrorCheck( vkCreateDescriptorPool( _renderer->GetDevice(), &descriptorPoolInfo, nullptr, &_descriptor_pool),
 										"Unable to create descriptor pool.", "Descriptor pool created." );
+
+	// material texture sets, bindless ones come from a pool created for update after bind.
+	std::vector<VkDescriptorPoolSize> texture_pool_sizes =
+	{
+		Structs::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _texture_slots * set_count),
+	};
+
+	VkDescriptorPoolCreateInfo texture_pool_info = Structs::DescriptorPoolCreateInfo(texture_pool_sizes, set_count);
+#ifdef VK_EXT_descriptor_indexing
+	if (_bindless)
+		texture_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+#endif
+	ErrorCheck( vkCreateDescriptorPool( _renderer->GetDevice(), &texture_pool_info, nullptr, &_texture_descriptor_pool),
+										"Unable to create material texture descriptor pool.", "Material texture descriptor pool created." );
 }
 
 void PathTracer::_AllocateDescriptorSets()
 {
 	VkDescriptorSetAllocateInfo allocate_info = Structs::DescriptorSetAllocateInfo(_descriptor_pool, _descriptor_set_layout);
 
-	// alocate descriptor sets for 2 swapchain images.
-	for (int i = 0; i < 2; i++)
+	// alocate descriptor sets for every frame in flight.
+	_descriptor_sets.resize(BUILD_FRAMES_IN_FLIGHT);
+	for (size_t i = 0; i < _descriptor_sets.size(); i++)
 	{
-		//  sampled image
 		ErrorCheck(vkAllocateDescriptorSets(_renderer->GetDevice(), &allocate_info, &_descriptor_sets[i]),
 			"Unable to allocate descriptor set.", "Descriptor set allocated image.");
+	}
 
+	// written before their frame first records, see _WriteTextureSet().
+	VkDescriptorSetAllocateInfo texture_allocate_info = Structs::DescriptorSetAllocateInfo(_texture_descriptor_pool, _texture_set_layout);
+	_texture_sets.resize(BUILD_FRAMES_IN_FLIGHT);
+	_texture_set_versions.assign(BUILD_FRAMES_IN_FLIGHT, _texture_version - 1);
+	for (size_t i = 0; i < _texture_sets.size(); i++)
+	{
+		ErrorCheck(vkAllocateDescriptorSets(_renderer->GetDevice(), &texture_allocate_info, &_texture_sets[i]),
+			"Unable to allocate material texture set.", "Material texture set allocated.");
+	}
+
+	_WriteDescriptorSets();
+}
+
+// rewritten whenever the images are recreated.
+void PathTracer::_WriteDescriptorSets()
+{
+	VkDescriptorImageInfo accumulation_descriptor = _accumulation->GetDescriptor();
+	VkDescriptorImageInfo preview_descriptor = _preview->GetDescriptor();
+	VkDescriptorImageInfo guide_descriptor = _guide->GetDescriptor();
+
+	for (uint32_t i = 0; i < (uint32_t)_descriptor_sets.size(); i++)
+	{
+		VkDescriptorImageInfo display_descriptor = _displays[i]->GetDescriptor();
 
 		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
 		{
-			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0, &_renderer->GetWindow()->GetPresentation()->GetPresentationImageDescriptor(i == 0 ? 1 : 0)),             // Binding 0 : Sampled image (read)
-			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &_renderer->GetWindow()->GetPresentation()->GetPresentationImageDescriptor(i)),			// Binding 1 : Sampled image (write)
-			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, _uniform_general_buffer->GetDescriptorInfo()),			
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &accumulation_descriptor),             // Binding 0 : Accumulation image (read / write)
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &display_descriptor),					// Binding 1 : Displayed image (write)
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2, _view_ring->GetDescriptorInfo()),	// Binding 2 : Camera and tile, offset picked at bind time
 			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, _uniform_light_buffer->GetDescriptorInfo()),	
 			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, _uniform_planes_buffer->GetDescriptorInfo()),
-			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, _uniform_spheres_buffer->GetDescriptorInfo())
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, _uniform_spheres_buffer->GetDescriptorInfo()),
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, &preview_descriptor),				// Binding 6 : Preview color (read / write)
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 7, &guide_descriptor),					// Binding 7 : Preview depth / normal guide (read / write)
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 13, _work_buffer->GetDescriptorInfo()),		// Binding 13 : Persistent threads pixel counter
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 14, _packed_planes_buffer->GetDescriptorInfo()),	// Binding 14 : Packed planes
+			Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 15, _packed_spheres_buffer->GetDescriptorInfo())	// Binding 15 : Packed spheres
 		};
 
+		// only the wavefront kernels use the queues, they stay unwritten until it is turned on.
+		if (_queues_buffer)
+		{
+			computeWriteDescriptorSets.push_back(Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, _ray_queue_buffer->GetDescriptorInfo()));
+			computeWriteDescriptorSets.push_back(Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9, _hit_queue_buffer->GetDescriptorInfo()));
+			computeWriteDescriptorSets.push_back(Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10, _shadow_queue_buffer->GetDescriptorInfo()));
+			computeWriteDescriptorSets.push_back(Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 11, _radiance_buffer->GetDescriptorInfo()));
+			computeWriteDescriptorSets.push_back(Structs::WriteDescriptorSet(_descriptor_sets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12, _queues_buffer->GetDescriptorInfo()));
+		}
+
 		vkUpdateDescriptorSets( _renderer->GetDevice(), (uint32_t)computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL );
 	}
 }
 
+// rewritten once the frame's fence is signaled after textures were handed out or finished loading.
+// slots still loading get the white texture, the fixed array fills every slot with it.
+void PathTracer::_WriteTextureSet(uint32_t frame)
+{
+	if (_texture_set_versions[frame] == _texture_version)
+		return;
+	_texture_set_versions[frame] = _texture_version;
+
+	uint32_t count = _bindless ? (uint32_t)_textures.size() : _texture_slots;
+	if (count == 0)
+		return;
+
+	std::vector<VkDescriptorImageInfo> image_descriptors(count, _default_texture->GetDescriptor());
+	for (uint32_t i = 0; i < (uint32_t)_textures.size(); i++)
+	{
+		if (_textures[i])
+			image_descriptors[i] = _textures[i]->GetDescriptor();
+	}
+
+	VkWriteDescriptorSet write_descriptor_set = Structs::WriteDescriptorSet(_texture_sets[frame], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, image_descriptors.data());
+	write_descriptor_set.descriptorCount = count;
+	vkUpdateDescriptorSets( _renderer->GetDevice(), 1, &write_descriptor_set, 0, NULL );
+}
+
 
 // pipeline
 void PathTracer::_CreatePipelineLayout()
 {
-	VkPipelineLayoutCreateInfo create_info = Structs::PipelineLayoutCreateInfo(_descriptor_set_layout);
+	// general data changes with every dispatch, it is pushed instead of living in a buffer.
+	static_assert(sizeof(General) <= 128, "General has to fit the guaranteed push constant size.");
+	VkPushConstantRange push_constant_range = Structs::PushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(General));
+	VkPipelineLayoutCreateInfo create_info = Structs::PipelineLayoutCreateInfo(_descriptor_set_layout, &push_constant_range);
+
+	// set 0 scene and images, set 1 material textures.
+	VkDescriptorSetLayout set_layouts[] = { _descriptor_set_layout, _texture_set_layout };
+	create_info.setLayoutCount	= 2;
+	create_info.pSetLayouts		= set_layouts;
 	ErrorCheck( vkCreatePipelineLayout(_renderer->GetDevice(), &create_info, nullptr, &_pipeline_layout),
 				"Unable to create compute pipeline layout.", "Compute pipeline layout has been created." );
 }
 
+// starts from the previous launch's cache when the driver did not change.
 void PathTracer::_CreatePipelineCache()
 {
-	VkPipelineCacheCreateInfo create_info = Structs::PipelineCacheCreateInfo();
-	ErrorCheck( vkCreatePipelineCache(_renderer->GetDevice(), &create_info, nullptr, &_pipeline_cache),
-				"Unable to create pipeline cache.", "Pipeline cache has been created." );
+	_pipeline_cache = new PipelineCache(_renderer, "shaders/pipeline");
 }
 
 void PathTracer::_CreatePipeline()
+{
+	// one path tracer pipeline per quality preset, _pipeline_index picks one.
+	for (uint32_t i = 0; i < QUALITY_COUNT; i++)
+	{
+		Specialization specialization = { quality_presets[i], _packed_scene ? VK_TRUE : VK_FALSE };
+		VkSpecializationInfo specialization_info = PipelineSpecialization(specialization);
+		_pipelines.push_back(_LoadPipeline(_bindless ? "pathtracer.bindless" : "pathtracer", &specialization_info));
+	}
+
+	// preview upsampling, same layout as the path tracer, no material textures.
+	_upsample_pipeline = _LoadPipeline("upsample");
+	Shader::DestroyShaderModules(_renderer->GetDevice());
+
+	// no pipelines are created after this, saved now so workers that get killed still leave it behind.
+	if (!_pipeline_cache->IsLoaded())
+		_pipeline_cache->Save();
+}
+
+VkPipeline PathTracer::_LoadPipeline(std::string shader_name, const VkSpecializationInfo * specialization_info)
 {
 	VkComputePipelineCreateInfo create_info = Structs::ComputePipelineCreateInfo(_pipeline_layout);
 
-	std::vector<std::string> shaderNames = { "pathtracer" };	// One pipeline for shader
-	for (auto& shaderName : shaderNames)
-	{
-		std::string fileName	= "shaders/" + shaderName + ".comp.spv";
-		create_info.stage		= Shader::LoadShaderStage(fileName.c_str() , _renderer->GetDevice(), VK_SHADER_STAGE_COMPUTE_BIT);
+	std::string fileName	= "shaders/" + shader_name + ".comp.spv";
+	create_info.stage		= Shader::LoadShaderStage(fileName.c_str() , _renderer->GetDevice(), VK_SHADER_STAGE_COMPUTE_BIT);
+	create_info.stage.pSpecializationInfo = specialization_info;
 
-		VkPipeline pipeline;
-		ErrorCheck( vkCreateComputePipelines( _renderer->GetDevice(), _pipeline_cache, 1, &create_info, nullptr, &pipeline ), "Unable to create compute pipeline.", "Compute pipeline created");
+	VkPipeline pipeline;
+	ErrorCheck( vkCreateComputePipelines( _renderer->GetDevice(), _pipeline_cache->GetCache(), 1, &create_info, nullptr, &pipeline ), "Unable to create compute pipeline.", "Compute pipeline created");
 
-		_pipelines.push_back(pipeline);
-	}
+	return pipeline;
 }
 
 
 // command buffers
 void PathTracer::_CreateCommandPoolAndBuffers()
 {
-	_command_buffers.resize(2);
-
+	// command buffers are re-recorded, so they have to be resettable.
 	VkCommandPoolCreateInfo create_info = Structs::CommandPoolCreateInfo(_renderer->GetComputeFamilyIndex() );
+	create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	ErrorCheck(vkCreateCommandPool(_renderer->GetDevice(), &create_info, nullptr, &_command_pool),
 		"Unable to create a compute command pool.", "Compute queue command pool created.");
 
-	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _command_pool, 2 );
+	_AllocateCommandBuffers();
+}
+
+// one per frame in flight, recorded again every frame.
+void PathTracer::_AllocateCommandBuffers()
+{
+	_command_buffers.resize(BUILD_FRAMES_IN_FLIGHT);
+
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _command_pool, BUILD_FRAMES_IN_FLIGHT );
 	ErrorCheck(vkAllocateCommandBuffers(_renderer->GetDevice(), &allocate_info, &_command_buffers[0]),
 		"Unable to allocate compute command buffers.", "Compute Command buffers have been allocated.");
 }
 
-void PathTracer::_RecordCommandBuffers()
+void PathTracer::_RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t frame, bool preview)
 {
-	vkQueueWaitIdle( _renderer->GetComputeQueue() );
-	
 	VkCommandBufferBeginInfo cmd_buffer_begin_info = Structs::CommandBufferBeginInfo();
 
-	VkImageSubresourceRange image_subresource_range = Structs::ImageSubresourceRange( VK_IMAGE_ASPECT_COLOR_BIT );
+	// the previous frame may still be writing the images this one reads.
+	VkMemoryBarrier barrier_from_previous_frame = {};
+	barrier_from_previous_frame.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier_from_previous_frame.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+	barrier_from_previous_frame.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-	for (uint32_t i = 0; i < (uint32_t)_renderer->GetWindow()->GetPresentation()->GetSwapchainImages().size(); ++i) {
-
-		VkImageMemoryBarrier barrier_from_present_to_clear = {
-			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // VkStructureType                        sType
-			nullptr,                                    // const void                            *pNext
-			VK_ACCESS_MEMORY_READ_BIT,                  // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_TRANSFER_WRITE_BIT,               // VkAccessFlags                          dstAccessMask
-			VK_IMAGE_LAYOUT_UNDEFINED,                    // VkImageLayout                          oldLayout
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,       // VkImageLayout                          newLayout
-			VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               dstQueueFamilyIndex
-			_renderer->GetWindow()->GetPresentation()->GetSwapchainImages()[i],                       // VkImage                                image
-			image_subresource_range                     // VkImageSubresourceRange                subresourceRange
-		};
 
-		VkImageMemoryBarrier barrier_from_clear_to_present = {
-			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // VkStructureType                        sType
-			nullptr,                                    // const void                            *pNext
-			VK_ACCESS_TRANSFER_WRITE_BIT,               // VkAccessFlags                          srcAccessMask
-			VK_ACCESS_MEMORY_READ_BIT,                  // VkAccessFlags                          dstAccessMask
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,       // VkImageLayout                          oldLayout
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,            // VkImageLayout                          newLayout
-			VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               srcQueueFamilyIndex
-			VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               dstQueueFamilyIndex
-			_renderer->GetWindow()->GetPresentation()->GetSwapchainImages()[i],                       // VkImage                                image
-			image_subresource_range                     // VkImageSubresourceRange                subresourceRange
-		};
-	
+	ErrorCheck(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info),
+		"Unable to create command buffer begin info.");
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier_from_previous_frame, 0, nullptr, 0, nullptr);
 
-		ErrorCheck(vkBeginCommandBuffer(_command_buffers[i], &cmd_buffer_begin_info),
-			"Unable to create command buffer begin info.", "Compute command buffers created.");
+	vkCmdResetQueryPool(command_buffer, _query_pool, frame * 2, 2);
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _query_pool, frame * 2);
 
+	// workgroup size of the path tracer follows its preset.
+	uint32_t group_x		= quality_presets[_pipeline_index].local_size_x;
+	uint32_t group_y		= quality_presets[_pipeline_index].local_size_y;
+	uint32_t group_count_x	= (_width + group_x - 1) / group_x;
+	uint32_t group_count_y	= (_height + group_y - 1) / group_y;
+
+	// persistent threads only pay off when the grid has more workgroups than the gpu runs at once.
+	bool persistent = !preview && !_wavefront && _persistent_groups > 0 && _persistent_groups < group_count_x * group_count_y;
+	_uniform_general.persistent = persistent ? 1 : 0;
+
+	if (persistent)
+	{
+		// the previous frame's invocations may still fetch from the counter.
+		VkMemoryBarrier barrier_from_shader_to_clear = {};
+		barrier_from_shader_to_clear.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier_from_shader_to_clear.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+		barrier_from_shader_to_clear.dstAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		VkMemoryBarrier barrier_from_clear_to_shader = {};
+		barrier_from_clear_to_shader.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier_from_clear_to_shader.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier_from_clear_to_shader.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier_from_shader_to_clear, 0, nullptr, 0, nullptr);
+		vkCmdFillBuffer(command_buffer, _work_buffer->GetBuffer(), 0, sizeof(uint32_t), 0);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier_from_clear_to_shader, 0, nullptr, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelines[_pipeline_index]);
+	VkDescriptorSet descriptor_sets[] = { _descriptor_sets[frame], _texture_sets[frame] };
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline_layout, 0, 2, descriptor_sets, 1, &_view_offset);
+	vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(General), &_uniform_general);
+
+	if (!preview && _wavefront)
+	{
+		_RecordWavefront(command_buffer);
+	}
+	else if (persistent)
+	{
+		vkCmdDispatch(command_buffer, _persistent_groups, 1, 1);
+	}
+	else if (!preview)
+	{
+		vkCmdDispatch(command_buffer, group_count_x, group_count_y, 1);
+	}
+	else
+	{
+		// one traced pixel per block, then upsample to full resolution guided by the primary hits.
+		uint32_t preview_width	= (_width + _preview_scale - 1) / _preview_scale;
+		uint32_t preview_height	= (_height + _preview_scale - 1) / _preview_scale;
+		vkCmdDispatch(command_buffer, (preview_width + group_x - 1) / group_x, (preview_height + group_y - 1) / group_y, 1);
+
+		VkMemoryBarrier barrier_from_trace_to_upsample = {};
+		barrier_from_trace_to_upsample.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier_from_trace_to_upsample.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+		barrier_from_trace_to_upsample.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier_from_trace_to_upsample, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _upsample_pipeline);
+		vkCmdDispatch(command_buffer, (_width + 15) / 16, (_height + 15) / 16, 1);
+	}
+
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _query_pool, frame * 2 + 1);
+	_timestamps_written[frame] = true;
+
+	vkEndCommandBuffer(command_buffer);
+}
+
+// queues are sized by the paths in flight, not by the resolution, so they survive resizes.
+void PathTracer::_CreateWavefront()
+{
+	std::cout << "-------------------------------------- Creating wavefront kernels, queues -----------------------------------" << std::endl;
+
+	_CreateWavefrontPipelines();
+
+	// at most one ray per path in each queue, a path adds one shadow ray or one light item per bounce.
+	VkBufferUsageFlags usage	= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	Queues queues				= {};
+	_ray_queue_buffer			= new DeviceBuffer(_renderer, usage, nullptr, 2 * BUILD_WAVEFRONT_PATHS * wavefront_item_size);
+	_hit_queue_buffer			= new DeviceBuffer(_renderer, usage, nullptr, BUILD_WAVEFRONT_PATHS * wavefront_item_size);
+	_shadow_queue_buffer		= new DeviceBuffer(_renderer, usage, nullptr, 2 * BUILD_WAVEFRONT_PATHS * wavefront_item_size);
+	_radiance_buffer			= new DeviceBuffer(_renderer, usage, nullptr, BUILD_WAVEFRONT_PATHS * 3 * sizeof(uint32_t));
+	_queues_buffer				= new DeviceBuffer(_renderer, usage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &queues, sizeof(Queues));
+}
+
+// one pipeline per kernel and quality preset.
+void PathTracer::_CreateWavefrontPipelines()
+{
+	for (uint32_t i = 0; i < QUALITY_COUNT; i++)
+	{
+		Specialization specialization = { quality_presets[i], _packed_scene ? VK_TRUE : VK_FALSE };
+		VkSpecializationInfo specialization_info = PipelineSpecialization(specialization);
+		for (uint32_t k = 0; k < WAVEFRONT_KERNEL_COUNT; k++)
+			_wavefront_pipelines.push_back(_LoadPipeline(std::string(wavefront_kernel_names[k]) + (_bindless ? ".bindless" : ""), &specialization_info));
+	}
+	Shader::DestroyShaderModules(_renderer->GetDevice());
 
-		vkCmdPipelineBarrier(_command_buffers[i], VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_present_to_clear);
+	// a loaded cache may come from a launch without them.
+	_pipeline_cache->Save();
+}
 
-		vkCmdBindPipeline(_command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, _pipelines[_pipeline_index]);
-		vkCmdBindDescriptorSets(_command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline_layout, 0, 1, &_descriptor_sets[i], 0, 0);
+// every sample runs raygen, then extend, shade and shadow once per possible bounce of a path and resolve.
+// queue lengths never come back to the cpu, empty queues dispatch no workgroups.
+void PathTracer::_RecordWavefront(VkCommandBuffer command_buffer)
+{
+	const QualityPreset &	preset		= quality_presets[_pipeline_index];
+	const VkPipeline *		pipelines	= &_wavefront_pipelines[_pipeline_index * WAVEFRONT_KERNEL_COUNT];
+
+	uint32_t pixels		= _width * _height;
+	uint32_t passes		= (pixels + BUILD_WAVEFRONT_PATHS - 1) / BUILD_WAVEFRONT_PATHS;
+	uint32_t bounces	= preset.max_bounce_per_trace + 1 + (preset.bounce_count > 1 ? preset.ray_count : 0);
+
+	// converged samples are not traced, resolve keeps showing the accumulation.
+	uint32_t frame		= (uint32_t)_uniform_general.frame;
+	uint32_t remaining	= frame < (uint32_t)preset.frame_count ? preset.frame_count - frame : 0;
+	uint32_t samples	= (uint32_t)_uniform_general.samples < remaining ? (uint32_t)_uniform_general.samples : remaining;
+
+	// every kernel reads what the one before wrote, the indirect ones their dispatch size too.
+	VkMemoryBarrier barrier_between_kernels = {};
+	barrier_between_kernels.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier_between_kernels.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+	barrier_between_kernels.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	General general = _uniform_general;
+	auto dispatch = [&](WavefrontKernel kernel, uint32_t group_count, VkDeviceSize indirect_offset)
+	{
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier_between_kernels, 0, nullptr, 0, nullptr);
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[kernel]);
+		vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(General), &general);
 
-		vkCmdPipelineBarrier(_command_buffers[i], VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_clear_to_present);
+		// no group count takes the dispatch size from the queues.
+		if (group_count > 0)	vkCmdDispatch(command_buffer, group_count, 1, 1);
+		else					vkCmdDispatchIndirect(command_buffer, _queues_buffer->GetBuffer(), indirect_offset);
+	};
 
-		vkCmdDispatch(_command_buffers[i], 800 / 16, 610 / 16, 1);
+	for (uint32_t s = 0; s < (samples > 0 ? samples : 1); s++)
+	{
+		general.frame	= (int)(frame + s);
+		general.samples	= samples > 0 ? 1 : 0;
 
-		vkEndCommandBuffer(_command_buffers[i]);
+		for (uint32_t p = 0; p < passes; p++)
+		{
+			uint32_t offset		= p * BUILD_WAVEFRONT_PATHS;
+			uint32_t paths		= pixels - offset < BUILD_WAVEFRONT_PATHS ? pixels - offset : BUILD_WAVEFRONT_PATHS;
+			uint32_t groups		= (paths + wavefront_group_size - 1) / wavefront_group_size;
+			general.path_offset	= (int)offset;
+
+			if (general.samples > 0)
+			{
+				dispatch(WAVEFRONT_RAYGEN, groups, 0);
+
+				for (uint32_t b = 0; b < bounces; b++)
+				{
+					general.queue = (int)(b % 2);
+
+					dispatch(WAVEFRONT_EXTEND, 0, offsetof(Queues, extend_dispatch));
+					general.stage = 0;
+					dispatch(WAVEFRONT_QUEUES, 1, 0);
+					dispatch(WAVEFRONT_SHADE, 0, offsetof(Queues, shade_dispatch));
+					general.stage = 1;
+					dispatch(WAVEFRONT_QUEUES, 1, 0);
+					dispatch(WAVEFRONT_SHADOW, 0, offsetof(Queues, shadow_dispatch));
+				}
+			}
+
+			dispatch(WAVEFRONT_RESOLVE, groups, 0);
+		}
 	}
 }
 
-void PathTracer::_CreateFence()
+// the fence guards the whole frame, trace and blit. the semaphore hands the traced image to the blit.
+void PathTracer::_CreateSyncObjects()
 {
+	_fences.resize(BUILD_FRAMES_IN_FLIGHT);
+	_semaphores_traced.resize(BUILD_FRAMES_IN_FLIGHT);
+
 	VkFenceCreateInfo fence_create_info = Structs::FenceCreateInfo();
-	ErrorCheck( vkCreateFence(_renderer->GetDevice(), &fence_create_info, nullptr, &_fence),
-		"Unable to create compute fence.", "Compute fence successfully created" );
+	for (uint32_t i = 0; i < BUILD_FRAMES_IN_FLIGHT; i++)
+	{
+		ErrorCheck( vkCreateFence(_renderer->GetDevice(), &fence_create_info, nullptr, &_fences[i]),
+			"Unable to create compute fence.", "Compute fence successfully created" );
+
+		ErrorCheck( vkCreateSemaphore(_renderer->GetDevice(), &Structs::SemaphoreCreateInfo(), nullptr, &_semaphores_traced[i]),
+			"Unable to create a semaphore.", "Semaphore traced successfully created." );
+	}
+}
+
+// two timestamps per frame in flight, around the dispatch.
+void PathTracer::_CreateQueryPool()
+{
+	_timestamp_period = _renderer->GetGPUProperties().limits.timestampPeriod;
+	_timed_samples.resize(BUILD_FRAMES_IN_FLIGHT, 0);
+	_timestamps_written.resize(BUILD_FRAMES_IN_FLIGHT, false);
+
+	// the compute queue may count with fewer bits and wrap, or not count at all. then the batch stays at one sample.
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(_renderer->GetGPU(), &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(_renderer->GetGPU(), &family_count, families.data());
+
+	uint32_t valid_bits	= families[_renderer->GetComputeFamilyIndex()].timestampValidBits;
+	_timestamp_mask		= valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+	if (valid_bits == 0)
+	{
+		std::cout << "Compute queue has no timestamps, the sample budget is ignored." << std::endl;
+		_timestamp_period = 0.0f;
+	}
+
+	VkQueryPoolCreateInfo create_info = {};
+	create_info.sType		= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType	= VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount	= 2 * BUILD_FRAMES_IN_FLIGHT;
+
+	ErrorCheck( vkCreateQueryPool(_renderer->GetDevice(), &create_info, nullptr, &_query_pool),
+		"Unable to create timestamp query pool.", "Timestamp query pool created." );
+}
+
+// the frame's fence is signaled, so its timestamps are final. scales the batch towards the budget.
+void PathTracer::_AdaptBatchSamples(uint32_t frame)
+{
+	if (_sample_budget <= 0.0f || _timestamp_period <= 0.0f)
+	{
+		_batch_samples = 1;
+		return;
+	}
+
+	// the first frames in flight have not written their queries yet.
+	if (!_timestamps_written[frame])
+		return;
+
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(_renderer->GetDevice(), _query_pool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return;
+
+	// previews and converged frames say nothing about the cost of a sample.
+	float milliseconds = ((timestamps[1] - timestamps[0]) & _timestamp_mask) * _timestamp_period / 1000000.0f;
+	if (_timed_samples[frame] == 0 || milliseconds <= 0.0f)
+		return;
+
+	// grow at most 2x per frame, a camera move right after can not stall for long.
+	float per_sample	= milliseconds / _timed_samples[frame];
+	float samples		= _sample_budget / per_sample;
+	if (samples > _batch_samples * 2.0f)	samples = _batch_samples * 2.0f;
+	if (samples > 256.0f)					samples = 256.0f;
+	_batch_samples		= samples > 1.0f ? (uint32_t)samples : 1;
+}
+
+// one time commands, only used outside of the render loop.
+VkCommandBuffer PathTracer::_BeginOneTimeCommands()
+{
+	VkCommandBuffer command_buffer;
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _command_pool, 1 );
+	ErrorCheck(vkAllocateCommandBuffers(_renderer->GetDevice(), &allocate_info, &command_buffer),
+		"Unable to allocate one time command buffer.");
+
+	VkCommandBufferBeginInfo cmd_buffer_begin_info = Structs::CommandBufferBeginInfo();
+	cmd_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info);
+
+	return command_buffer;
+}
+
+void PathTracer::_SubmitOneTimeCommands(VkCommandBuffer command_buffer)
+{
+	ErrorCheck(vkEndCommandBuffer(command_buffer), "Unable to record one time command buffer.");
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount	= 1;
+	submit_info.pCommandBuffers		= &command_buffer;
+
+	ErrorCheck(vkQueueSubmit(_renderer->GetComputeQueue(), 1, &submit_info, VK_NULL_HANDLE), "Unable to submit one time command buffer.");
+	vkQueueWaitIdle(_renderer->GetComputeQueue());
+
+	vkFreeCommandBuffers(_renderer->GetDevice(), _command_pool, 1, &command_buffer);
+}
+
+void PathTracer::_ClearStorageImage(Texture * texture, VkClearColorValue clear_color)
+{
+	VkCommandBuffer command_buffer = _BeginOneTimeCommands();
+
+	VkImageSubresourceRange image_subresource_range = Structs::ImageSubresourceRange( VK_IMAGE_ASPECT_COLOR_BIT );
+
+	// storage images live in general layout for their whole life.
+	VkImageMemoryBarrier barrier_from_undefined_to_general = {
+		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // VkStructureType                        sType
+		nullptr,                                    // const void                            *pNext
+		0,                                          // VkAccessFlags                          srcAccessMask
+		VK_ACCESS_TRANSFER_WRITE_BIT,               // VkAccessFlags                          dstAccessMask
+		VK_IMAGE_LAYOUT_UNDEFINED,                  // VkImageLayout                          oldLayout
+		VK_IMAGE_LAYOUT_GENERAL,                    // VkImageLayout                          newLayout
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               srcQueueFamilyIndex
+		VK_QUEUE_FAMILY_IGNORED,                    // uint32_t                               dstQueueFamilyIndex
+		texture->GetImage(),                        // VkImage                                image
+		image_subresource_range                     // VkImageSubresourceRange                subresourceRange
+	};
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier_from_undefined_to_general);
+	vkCmdClearColorImage(command_buffer, texture->GetImage(), VK_IMAGE_LAYOUT_GENERAL, &clear_color, 1, &image_subresource_range);
+
+	_SubmitOneTimeCommands(command_buffer);
+}
+
+// everything that makes accumulated samples incompatible.
+uint64_t PathTracer::_SceneHash()
+{
+	uint64_t hash = Checkpoint::Hash(&_uniform_light, sizeof(Light));
+	hash = Checkpoint::Hash(&_uniform_planes, sizeof(Planes), hash);
+	hash = Checkpoint::Hash(&_uniform_spheres, sizeof(Spheres), hash);
+	hash = Checkpoint::Hash(&quality_presets[_pipeline_index], sizeof(QualityPreset), hash);
+	hash = Checkpoint::Hash(&_packed_scene, sizeof(bool), hash);
+	return hash;
+}
+
+// captures the state belonging to the frame being dispatched, the texels follow from the readback.
+Readback::Consumer PathTracer::_CheckpointConsumer(std::string file_name)
+{
+	Checkpoint::Header header = {};
+	header.width			= _width;
+	header.height			= _height;
+	header.frame			= _uniform_general.frame + _uniform_general.samples - 1;
+	header.time				= _uniform_general.time;
+	header.sample_offset	= _uniform_general.sample_offset;
+	header.scene_hash		= _SceneHash();
+
+	glm::mat4x4 view = _camera->GetView();
+	memcpy(header.view, &view, sizeof(header.view));
+
+	return [header, file_name](const void * data, uint32_t width, uint32_t height)
+	{
+		if (Checkpoint::Write(file_name, header, data))
+			std::cout << "Checkpoint saved: " << file_name << " ( frame " << header.frame << " )" << std::endl;
+	};
+}
+
+// tile position is taken at capture time, the writer crops tiles hanging over the image edge.
+Readback::Consumer PathTracer::_TileConsumer()
+{
+	TileWriter *	writer		= _tile_writer;
+	uint32_t		x			= (uint32_t)_uniform_view.tile_offset.x;
+	uint32_t		y			= (uint32_t)_uniform_view.tile_offset.y;
+	uint32_t		index		= _tile_index;
+	uint32_t		count		= _tile_count;
+
+	return [writer, x, y, index, count](const void * data, uint32_t width, uint32_t height)
+	{
+		if (writer->Write(reinterpret_cast<const float*>(data), x, y, width, height))
+			std::cout << "Tile " << index + 1 << " / " << count << " written." << std::endl;
+	};
+}
+
+void PathTracer::_SetTile(uint32_t index)
+{
+	_tile_index						= index;
+	_uniform_view.tile_offset		= glm::vec2( (index % _tile_columns) * _width, (index / _tile_columns) * _height );
+	_restart						= true;
+}
+
+// a tile worker renders every worker_count-th tile into a file laid out by the parent, 0 workers renders all of them into a new file.
+bool PathTracer::RenderTiles(std::string file_name, uint32_t image_width, uint32_t image_height, uint32_t samples, uint32_t worker_index, uint32_t worker_count)
+{
+	TileWriter * writer = new TileWriter(file_name, image_width, image_height, worker_count == 0);
+	if (!writer->IsOpen())
+	{
+		delete writer;
+		return false;
+	}
+
+	_tile_writer						= writer;
+	_tile_samples						= samples > 0 ? samples : 1;
+	_tile_step							= worker_count > 0 ? worker_count : 1;
+	_tile_columns						= (image_width + _width - 1) / _width;
+	_tile_count							= _tile_columns * ( (image_height + _height - 1) / _height );
+	_uniform_view.image_resolution		= glm::vec2(image_width, image_height);
+
+	// projection of the whole image, every tile takes its own part of it.
+	_camera->SetResolution(glm::vec2(image_width, image_height));
+	_SetTile(worker_index);
+
+	std::cout << "Rendering " << image_width << "x" << image_height << " in " << _tile_count << " tiles of " << _width << "x" << _height << std::endl;
+	return true;
+}
+
+bool PathTracer::IsFinished()
+{
+	return _tile_writer && _tile_index >= _tile_count && _readback->IsIdle();
+}
+
+bool PathTracer::Resume(std::string file_name)
+{
+	Checkpoint checkpoint(file_name);
+	if (!checkpoint.IsValid())
+	{
+		std::cout << "Checkpoint \"" << file_name << "\" is not valid, starting over." << std::endl;
+		return false;
+	}
+
+	const Checkpoint::Header * header = checkpoint.GetHeader();
+	if (header->width != _width || header->height != _height || header->scene_hash != _SceneHash())
+	{
+		std::cout << "Checkpoint \"" << file_name << "\" belongs to a different scene or resolution, starting over." << std::endl;
+		return false;
+	}
+
+	// continuing another sample range would draw samples twice once the partials are merged.
+	if (header->sample_offset != (uint32_t)_uniform_general.sample_offset)
+	{
+		std::cout << "Checkpoint \"" << file_name << "\" starts at sample " << header->sample_offset << ", not " << _uniform_general.sample_offset << ", starting over." << std::endl;
+		return false;
+	}
+
+	// the copy reads a whole rgba32f image, large tiled resolutions go past 4 GiB.
+	VkDeviceSize pixel_size = (VkDeviceSize)_width * _height * 4 * sizeof(float);
+	if (checkpoint.GetPixelSize() < pixel_size)
+	{
+		std::cout << "Checkpoint \"" << file_name << "\" holds fewer pixels than the image, starting over." << std::endl;
+		return false;
+	}
+
+	// staged straight from the mapped file.
+	DataBuffer staging(_renderer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, const_cast<void*>(checkpoint.GetPixels()), pixel_size);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount		= 1;
+	region.imageExtent						= { _width, _height, 1 };
+
+	VkMemoryBarrier barrier_from_transfer_to_shader = {};
+	barrier_from_transfer_to_shader.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier_from_transfer_to_shader.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier_from_transfer_to_shader.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	VkCommandBuffer command_buffer = _BeginOneTimeCommands();
+	vkCmdCopyBufferToImage(command_buffer, staging.GetBuffer(), _accumulation->GetImage(), VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier_from_transfer_to_shader, 0, nullptr, 0, nullptr);
+	_SubmitOneTimeCommands(command_buffer);
+
+	glm::mat4x4 view;
+	memcpy(&view, header->view, sizeof(header->view));
+	_camera->SetView(view);
+
+	_uniform_general.frame		= header->frame;
+	_uniform_general.samples	= 1;
+	_uniform_general.time		= header->time;
+
+	std::cout << "Resumed from checkpoint \"" << file_name << "\" at frame " << header->frame << std::endl;
+	return true;
+}
+
+void PathTracer::SetCheckpoint(std::string file_name, float interval_seconds)
+{
+	_checkpoint_file		= file_name;
+	_checkpoint_interval	= interval_seconds;
+	_checkpoint_time		= std::chrono::steady_clock::now();
+}
+
+void PathTracer::SaveImage(std::string file_name)
+{
+	_capture_file = file_name;
+}
+
+bool PathTracer::IsSaving()
+{
+	return !_capture_file.empty() || !_readback->IsIdle();
+}
+
+// samples past the preset's FRAME_COUNT are not accumulated, so they are not counted either.
+uint32_t PathTracer::GetSampleCount()
+{
+	uint32_t count			= _uniform_general.frame + _uniform_general.samples;
+	uint32_t max_samples	= (uint32_t)quality_presets[_pipeline_index].frame_count;
+	return count < max_samples ? count : max_samples;
+}
+
+// 1 turns the preview off.
+void PathTracer::SetPreviewScale(uint32_t scale)
+{
+	_preview_scale = scale > 1 ? scale : 1;
+}
+
+// swapchain was recreated, the accumulation survives unless the render size changed.
+void PathTracer::Resize(uint32_t width, uint32_t height)
+{
+	vkQueueWaitIdle( _renderer->GetComputeQueue() );
+
+	// tiles keep their size, the window only shows them.
+	if (!_tile_writer && (width != _width || height != _height))
+	{
+		_DestroyImages();
+		_width										= width;
+		_height										= height;
+		_CreateImages();
+
+		_camera->SetResolution(glm::vec2(width, height));
+		_uniform_general.resolution					= glm::vec2(width, height);
+		_uniform_view.image_resolution				= glm::vec2(width, height);
+		_restart									= true;
+	}
+
+	_WriteDescriptorSets();
+}
+
+// switches to another prebuilt pipeline, samples of different presets do not mix.
+void PathTracer::SetQuality(Quality quality)
+{
+	if (quality >= QUALITY_COUNT || quality == _pipeline_index)
+		return;
+
+	_pipeline_index	= quality;
+	_restart		= true;
+}
+
+bool PathTracer::ParseQuality(std::string name, Quality & quality)
+{
+	for (uint32_t i = 0; i < QUALITY_COUNT; i++)
+	{
+		if (name == quality_names[i])
+		{
+			quality = (Quality)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// FRAME_COUNT the preset's pipelines are specialized with, accumulation stops there.
+uint32_t PathTracer::GetMaxSamples(Quality quality)
+{
+	return quality < QUALITY_COUNT ? (uint32_t)quality_presets[quality].frame_count : 0;
+}
+
+// gpu time one dispatch may take, more samples are traced per presented frame when there is room. 0 traces one.
+void PathTracer::SetSampleBudget(float milliseconds)
+{
+	_sample_budget = milliseconds;
+}
+
+// accumulation stops at exactly this many samples, batches are cut short to not overshoot it. 0 never stops.
+void PathTracer::SetSampleLimit(uint32_t samples)
+{
+	_sample_limit = samples;
+}
+
+// same samples as the megakernel, traced by separate kernels through storage buffer queues. previews stay on the megakernel.
+void PathTracer::SetWavefront(bool enabled)
+{
+	if (enabled && !_queues_buffer)
+	{
+		vkQueueWaitIdle( _renderer->GetComputeQueue() );
+		_CreateWavefront();
+		_WriteDescriptorSets();
+	}
+
+	_wavefront = enabled;
+}
+
+// pipelines from the .spv files as they are now, for shaders rebuilt while rendering.
+// frames in flight finish with the old pipelines, they are destroyed once those retired.
+void PathTracer::ReloadPipelines()
+{
+	std::cout << "-------------------------------------- Reloading pipelines -----------------------------------" << std::endl;
+
+	std::vector<VkPipeline> retired = _pipelines;
+	retired.insert(retired.end(), _wavefront_pipelines.begin(), _wavefront_pipelines.end());
+	retired.push_back(_upsample_pipeline);
+
+	_pipelines.clear();
+	_wavefront_pipelines.clear();
+	_CreatePipeline();
+	if (_queues_buffer)
+		_CreateWavefrontPipelines();
+
+	VkDevice device = _renderer->GetDevice();
+	_renderer->GetDeletionQueue()->Push([device, retired]()
+	{
+		for (VkPipeline pipeline : retired)
+			vkDestroyPipeline(device, pipeline, nullptr);
+	});
+
+	// samples of the old shaders do not mix with the new ones.
+	_restart = true;
+}
+
+// planes and spheres read from their packed copies, half the bytes in the intersection loops for fp16 colors and unorm8 factors.
+void PathTracer::SetPackedScene(bool enabled)
+{
+	if (enabled == _packed_scene)
+		return;
+
+	_packed_scene = enabled;
+	ReloadPipelines();
+}
+
+// workgroups that loop over the pixels instead of one invocation per pixel, a few per compute unit fill the gpu. 0 follows the grid.
+void PathTracer::SetPersistentGroups(uint32_t groups)
+{
+	_persistent_groups = groups;
+}
+
+// decoded and uploaded in the background. the slot materials index is handed out right away, -1 when none is left.
+int PathTracer::LoadTexture(std::string file_name)
+{
+	if ((uint32_t)_textures.size() >= _texture_slots)
+	{
+		std::cout << "No material texture slot left for \"" << file_name << "\", " << _texture_slots << " are in use." << std::endl;
+		return -1;
+	}
+
+	int slot = (int)_textures.size();
+	_textures.push_back(nullptr);
+	_uniform_general.texture_count = (int)_textures.size();
+	_texture_version++;
+
+	// samples traced with the white texture do not mix with the textured ones.
+	_texture_streamer->Load(file_name, [this, slot](Texture * texture)
+	{
+		if (texture == nullptr)
+			return;
+
+		_textures[slot] = texture;
+		_texture_version++;
+		_restart = true;
+	});
+	return slot;
+}
+
+// workers of one distributed render take disjoint parts of the random sequence.
+void PathTracer::SetSampleOffset(uint32_t sample_offset)
+{
+	_uniform_general.sample_offset = (int)sample_offset;
 }
 
 void PathTracer::Dispatch()
 {
-	// update camera
-	bool updated = _camera->Update();
+	// hand finished copies over to the writer thread, take finished textures from the streamer.
+	_readback->Poll();
+	_texture_streamer->Poll();
+
+	// update camera, tiles keep it still and restart accumulation on their own.
+	bool updated	= _restart;
+	_restart		= false;
+	if (_tile_writer)
+	{
+		_uniform_view.inverse_projection_view = _camera->GetTileInverseProjectionView(_uniform_view.tile_offset, _uniform_general.resolution, _uniform_view.image_resolution);
+	}
+	else
+	{
+		updated |= _camera->Update();
+		_uniform_view.inverse_projection_view = _camera->GetInverseProjectionView();
+	}
 
-	// do stuff with uniforms
-	_uniform_general.inverse_projection_view = _camera->GetInverseProjectionView();
-	updated ? _uniform_general.frame = 0 : _uniform_general.frame += 1;
+	// moving cameras get the low resolution preview, accumulation starts over once the camera stops.
+	bool preview = updated && _preview_scale > 1 && !_tile_writer;
+	(updated || _previewing) ? _uniform_general.frame = 0 : _uniform_general.frame += _uniform_general.samples;
+	_uniform_general.preview_scale = preview ? _preview_scale : 1;
+	_previewing = preview;
+
+	// only waits for the frame that last used this slot, the others keep running.
+	uint32_t frame = _renderer->GetWindow()->GetPresentation()->GetFrameIndex();
+	vkWaitForFences(_renderer->GetDevice(), 1, &_fences[frame], VK_TRUE, UINT64_MAX);
+	vkResetFences(_renderer->GetDevice(), 1, &_fences[frame]);
+
+	// nothing uses this frame's material textures any more, nor what was deleted while it was last recorded.
+	_renderer->GetDeletionQueue()->Collect(frame);
+	_WriteTextureSet(frame);
+
+	// samples of this dispatch, tiles stop at their own sample count and nothing goes past the preset's FRAME_COUNT.
+	_AdaptBatchSamples(frame);
+	uint32_t limit		= _tile_writer ? _tile_samples : _sample_limit;
+	uint32_t max_limit	= (uint32_t)quality_presets[_pipeline_index].frame_count;
+	limit				= limit > 0 && limit < max_limit ? limit : max_limit;
+	uint32_t samples	= preview ? 1 : _batch_samples;
+	if (!preview)
+	{
+		uint32_t accumulated	= (uint32_t)_uniform_general.frame;
+		uint32_t remaining		= limit > accumulated ? limit - accumulated : 0;
+		samples					= samples < remaining ? samples : remaining;
+	}
+	_uniform_general.samples = (int)samples;
+	_timed_samples[frame]	 = preview ? 0 : samples;
+
+	// do stuff with uniforms, general is pushed while recording, the view goes to this frame's ring region.
 	_uniform_general.time += 0.01f;
-	_uniform_general_buffer->Update(_renderer, &_uniform_general);
-	//_uniform_light_buffer->Update(_renderer, &_uniform_light);
+	_view_ring->Begin(frame);
+	_view_offset = _view_ring->Push(&_uniform_view, sizeof(View));
+	//_uniform_light_buffer->Update(&_uniform_light);
+
 
+	_RecordCommandBuffer(_command_buffers[frame], frame, preview);
 
-	// prepare frame
-	uint32_t image_index;
-	image_index = _renderer->GetWindow()->GetPresentation()->PrepareFrame();
+	// periodic checkpoint, shares the readback with image captures.
+	bool checkpoint = !_checkpoint_file.empty() && !_tile_writer &&
+					  std::chrono::duration<float>(std::chrono::steady_clock::now() - _checkpoint_time).count() >= _checkpoint_interval;
 
-	// prepare fences
-	vkWaitForFences(_renderer->GetDevice(), 1, &_fence, VK_TRUE, UINT64_MAX);
-	vkResetFences(_renderer->GetDevice(), 1, &_fence);
+	// a finished tile keeps accumulating until the readback ring has room for it.
+	bool tile = _tile_writer && _tile_index < _tile_count && GetSampleCount() >= _tile_samples;
 
-	// submit queue
-	VkSubmitInfo submit_info = Structs::SubmitInfo( _command_buffers[image_index],
-													_renderer->GetWindow()->GetPresentation()->GetSemaphoreImageAvailable(),
-													_renderer->GetWindow()->GetPresentation()->GetSemaphoreRenderingFinished(),
-													{ VK_PIPELINE_STAGE_TRANSFER_BIT });
+	// a capture is skipped, not waited for, while the readback ring is busy.
+	bool capture = (!_capture_file.empty() || checkpoint || tile) && !preview && _readback->IsAvailable();
 
-	ErrorCheck( vkQueueSubmit(_renderer->GetComputeQueue(), 1, &submit_info, _fence), "Unable to submit compute queue" );
+	// submit queue, tracing does not wait for a swapchain image.
+	VkSubmitInfo submit_info = {};
+	submit_info.sType					= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount		= 1;
+	submit_info.pCommandBuffers			= &_command_buffers[frame];
+	submit_info.signalSemaphoreCount	= 1;
+	submit_info.pSignalSemaphores		= &_semaphores_traced[frame];
+
+	// when capturing the copy signals traced instead, so the blit waits for it too.
+	if (capture)
+		submit_info.signalSemaphoreCount = 0;
+
+	ErrorCheck( vkQueueSubmit(_renderer->GetComputeQueue(), 1, &submit_info, VK_NULL_HANDLE), "Unable to submit compute queue" );
+
+	if (capture)
+	{
+		// all consumers of this frame share one copy.
+		std::vector<Readback::Consumer> consumers;
+
+		// .ckpt captures keep the sample counts, they are partials for a distributed merge.
+		std::string file_name = _capture_file;
+		if (ImageFile::GetExtension(file_name) == "ckpt")
+		{
+			consumers.push_back(_CheckpointConsumer(file_name));
+		}
+		else if (!file_name.empty())
+		{
+			consumers.push_back([file_name](const void * data, uint32_t width, uint32_t height)
+			{
+				if (ImageFile::Write(file_name, reinterpret_cast<const float*>(data), width, height))
+					std::cout << "Image saved: " << file_name << std::endl;
+			});
+		}
+
+		if (checkpoint)		consumers.push_back(_CheckpointConsumer(_checkpoint_file));
+		if (tile)			consumers.push_back(_TileConsumer());
+
+		_readback->Capture( _renderer->GetComputeQueue(), _accumulation->GetImage(), VK_IMAGE_LAYOUT_GENERAL,
+							_semaphores_traced[frame],
+							[consumers](const void * data, uint32_t width, uint32_t height)
+							{
+								for (const Readback::Consumer & consumer : consumers)
+									consumer(data, width, height);
+							});
+
+		_capture_file.clear();
+		if (checkpoint)
+			_checkpoint_time = std::chrono::steady_clock::now();
+
+		// the copy is queued behind this frame's dispatch, so the next tile can start right away.
+		if (tile)
+		{
+			_tile_index += _tile_step;
+			if (_tile_index < _tile_count)
+				_SetTile(_tile_index);
+		}
+	}
 
-	// render frame to screen
-	_renderer->GetWindow()->GetPresentation()->RenderFrame(image_index);
+	// blit to screen on the graphics queue, its submit signals the frame's fence.
+	_renderer->GetWindow()->GetPresentation()->Present(_displays[frame]->GetImage(), { _width, _height }, _semaphores_traced[frame], _fences[frame]);
 }
\ No newline at end of file
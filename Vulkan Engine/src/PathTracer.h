@@ -2,26 +2,52 @@
 
 
 #include <vector>
+#include <chrono>
 #include <glm\glm.hpp>
 
+#include "BUILD_OPTIONS.h"
 #include "Platform.h"
 #include "Shared.h"
 #include "Texture.h"
+#include "Readback.h"
+#include "TextureStreamer.h"
+#include "ImageFile.h"
+#include "Checkpoint.h"
+#include "PipelineCache.h"
+#include "PackedScene.h"
 
 #include "base\Shader.h"
 #include "base\DataBuffer.h"
+#include "base\DeviceBuffer.h"
+#include "base\RingBuffer.h"
 #include "base\helpers\Structs.h"
 #include "../Camera.h"
 
 class PathTracer
 {
 public:
+	// pushed with every dispatch, changes between the dispatches of one frame.
 	struct General
 	{
-		glm::mat4x4   inverse_projection_view;
 		glm::vec2     resolution;
 		int           frame;
 		float         time;
+		int           sample_offset;
+		int           preview_scale;
+		int           samples;
+		int           path_offset;
+		int           queue;
+		int           stage;
+		int           persistent;
+		int           texture_count;
+	};
+
+	// camera and tile of a frame, a slice of the view ring bound with a dynamic offset.
+	struct View
+	{
+		glm::mat4x4   inverse_projection_view;
+		glm::vec2     image_resolution;
+		glm::vec2     tile_offset;
 	};
 
 	struct Light
@@ -43,6 +69,7 @@ public:
 		glm::vec4 albedo;
 		glm::vec4 specular;
 		glm::vec4 redf;      // reflection, emission, decay, fresnel
+		glm::ivec4 material = glm::ivec4(-1);	// x = albedo texture, -1 none
 	};
 
 	struct Sphere
@@ -51,6 +78,7 @@ public:
 		glm::vec4 albedo;
 		glm::vec4 specular;
 		glm::vec4 redf;      // reflection, emission, decay, fresnel
+		glm::ivec4 material = glm::ivec4(-1);	// x = albedo texture, -1 none
 	};
 
 	struct Planes
@@ -63,55 +91,222 @@ public:
 		Sphere           spheres[4];
 	};
 
+	// the same scene at half the size, see PackedScene.
+	struct PackedPlanes
+	{
+		PackedScene::Plane	planes[6];
+	};
+
+	struct PackedSpheres
+	{
+		PackedScene::Sphere	spheres[4];
+	};
+
+	// specialization constants of pathtracer.comp, one pipeline per preset.
+	enum Quality { QUALITY_DRAFT, QUALITY_MEDIUM, QUALITY_HIGH, QUALITY_ULTRA, QUALITY_COUNT };
+
+	struct QualityPreset
+	{
+		int32_t          frame_count;
+		int32_t          bounce_count;
+		int32_t          ray_count;
+		VkBool32         caustics;
+		int32_t          max_bounce_per_trace;
+		uint32_t         local_size_x;
+		uint32_t         local_size_y;
+	};
+
+	// every specialization constant of a pipeline, the preset and how the scene is stored.
+	struct Specialization
+	{
+		QualityPreset    preset;
+		VkBool32         packed_scene;
+	};
+
+	// kernels of the wavefront backend, one pipeline each per quality preset.
+	enum WavefrontKernel { WAVEFRONT_RAYGEN, WAVEFRONT_EXTEND, WAVEFRONT_QUEUES, WAVEFRONT_SHADE, WAVEFRONT_SHADOW, WAVEFRONT_RESOLVE, WAVEFRONT_KERNEL_COUNT };
+
+	// queue lengths and indirect dispatch sizes, same layout as wavefront.glsl.
+	struct Queues
+	{
+		uint32_t         extend_dispatch[4];
+		uint32_t         shade_dispatch[4];
+		uint32_t         shadow_dispatch[4];
+		uint32_t         ray_count[2];
+		uint32_t         hit_count;
+		uint32_t         shadow_count;
+		uint32_t         light_count;
+		uint32_t         padding[3];
+	};
+
 
 
 	private:
 		General         					_uniform_general = {};
+		View								_uniform_view = {};
 		Light                               _uniform_light = {};
 		Planes                              _uniform_planes = {};
 		Spheres                             _uniform_spheres = {};
 
-		DataBuffer				*			_uniform_general_buffer;
-		DataBuffer              *           _uniform_light_buffer;
-		DataBuffer              *           _uniform_planes_buffer;
-		DataBuffer              *           _uniform_spheres_buffer;
+		// scene data and the persistent threads counter, only the gpu touches them after the upload.
+		DeviceBuffer            *           _uniform_light_buffer;
+		DeviceBuffer            *           _uniform_planes_buffer;
+		DeviceBuffer            *           _uniform_spheres_buffer;
+		DeviceBuffer            *           _work_buffer;
+
+		// packed copies of planes and spheres, the pipelines read one or the other.
+		DeviceBuffer            *           _packed_planes_buffer;
+		DeviceBuffer            *           _packed_spheres_buffer;
+		bool								_packed_scene							= false;
+
+		// per frame data, one region per frame in flight.
+		RingBuffer				*			_view_ring								= nullptr;
+		uint32_t							_view_offset							= 0;
 
 
 		Renderer				*			_renderer								= nullptr;
 		Camera					*			_camera									= nullptr;
 
+		uint32_t							_width									= 0;
+		uint32_t							_height									= 0;
+		Texture					*			_accumulation							= nullptr;
+		Readback				*			_readback								= nullptr;
+		std::string							_capture_file;
+
+		// low resolution preview while the camera moves.
+		Texture					*			_preview								= nullptr;
+		Texture					*			_guide									= nullptr;
+		std::vector<Texture *>				_displays;
+		uint32_t							_preview_scale							= 2;
+		bool								_previewing								= false;
+
+		std::string							_checkpoint_file;
+		float								_checkpoint_interval					= 0.0f;
+		std::chrono::steady_clock::time_point	_checkpoint_time;
+
+		// offline tiles, the accumulation image is one tile.
+		TileWriter				*			_tile_writer							= nullptr;
+		uint32_t							_tile_samples							= 0;
+		uint32_t							_tile_index								= 0;
+		uint32_t							_tile_step								= 1;
+		uint32_t							_tile_columns							= 0;
+		uint32_t							_tile_count								= 0;
+
+		// accumulation starts over on the next dispatch.
+		bool								_restart								= false;
+
 		VkCommandPool			            _command_pool							= VK_NULL_HANDLE;
 		std::vector<VkCommandBuffer>		_command_buffers;				
 
-		VkFence								_fence									= VK_NULL_HANDLE;
+		std::vector<VkFence>				_fences;
+		std::vector<VkSemaphore>			_semaphores_traced;
+
+		// samples per dispatch, adapted to a gpu time budget measured with timestamps.
+		VkQueryPool							_query_pool								= VK_NULL_HANDLE;
+		float								_timestamp_period						= 0.0f;
+		uint64_t							_timestamp_mask							= ~0ull;		// timestampValidBits of the compute family
+		std::vector<bool>					_timestamps_written;
+		float								_sample_budget							= 0.0f;
+		uint32_t							_batch_samples							= 1;
+		uint32_t							_sample_limit							= 0;
+		std::vector<uint32_t>				_timed_samples;
 		VkDescriptorSetLayout				_descriptor_set_layout					= VK_NULL_HANDLE;
 		std::vector<VkDescriptorSet>		_descriptor_sets;				
 		VkPipelineLayout					_pipeline_layout						= VK_NULL_HANDLE;
 		std::vector<VkPipeline>				_pipelines;								
-		uint32_t							_pipeline_index							= 0;
+		uint32_t							_pipeline_index							= QUALITY_HIGH;
+		VkPipeline							_upsample_pipeline						= VK_NULL_HANDLE;
 		VkDescriptorPool					_descriptor_pool						= VK_NULL_HANDLE;
 
-		std::vector<VkShaderModule>			_shader_modules;
-		VkPipelineCache						_pipeline_cache							= VK_NULL_HANDLE;
+		// wavefront backend, created by the first SetWavefront(true).
+		bool								_wavefront								= false;
+		std::vector<VkPipeline>				_wavefront_pipelines;
+		DeviceBuffer			*			_ray_queue_buffer						= nullptr;
+		DeviceBuffer			*			_hit_queue_buffer						= nullptr;
+		DeviceBuffer			*			_shadow_queue_buffer					= nullptr;
+		DeviceBuffer			*			_radiance_buffer						= nullptr;
+		DeviceBuffer			*			_queues_buffer							= nullptr;
+
+		// persistent threads, 0 dispatches one invocation per pixel.
+		uint32_t							_persistent_groups						= 0;
+
+		// material textures in descriptor set 1, a slot per LoadTexture(), nullptr until it finished loading.
+		// indexed bindless when the device has descriptor indexing, otherwise a fixed array of slots.
+		TextureStreamer			*			_texture_streamer						= nullptr;
+		std::vector<Texture *>				_textures;
+		Texture					*			_default_texture						= nullptr;
+		bool								_bindless								= false;
+		uint32_t							_texture_slots							= 0;
+		VkDescriptorSetLayout				_texture_set_layout						= VK_NULL_HANDLE;
+		VkDescriptorPool					_texture_descriptor_pool				= VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet>		_texture_sets;
+		uint32_t							_texture_version						= 0;
+		std::vector<uint32_t>				_texture_set_versions;
+
+		PipelineCache			*			_pipeline_cache							= nullptr;
 
 	private:
 
+		void _CreateImages();
+		void _DestroyImages();
+
 		void _CreateDescriptorPool();
 		void _CreateDescriptorSetLayouts();
 		void _AllocateDescriptorSets();
+		void _WriteDescriptorSets();
+		void _WriteTextureSet(uint32_t frame);
 
 		void _CreatePipelineLayout();
 		void _CreatePipelineCache();
 		void _CreatePipeline();
+		VkPipeline _LoadPipeline(std::string shader_name, const VkSpecializationInfo * specialization_info = nullptr);
 
 		void _CreateCommandPoolAndBuffers();
-		void _RecordCommandBuffers();
-		void _CreateFence();
+		void _AllocateCommandBuffers();
+		void _RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t frame, bool preview);
+		void _CreateWavefront();
+		void _CreateWavefrontPipelines();
+		void _RecordWavefront(VkCommandBuffer command_buffer);
+		void _CreateSyncObjects();
+		void _CreateQueryPool();
+		void _AdaptBatchSamples(uint32_t frame);
+
+		VkCommandBuffer _BeginOneTimeCommands();
+		void _SubmitOneTimeCommands(VkCommandBuffer command_buffer);
+
+		void _ClearStorageImage(Texture * texture, VkClearColorValue color = {});
+		uint64_t _SceneHash();
+		Readback::Consumer _CheckpointConsumer(std::string file_name);
+		Readback::Consumer _TileConsumer();
+		void _SetTile(uint32_t index);
 
 	public:
-		PathTracer(Renderer * renderer, uint32_t width, uint32_t height);
+		PathTracer(Renderer * renderer, uint32_t width, uint32_t height, bool packed_scene = false);
 		~PathTracer();
 
 		void Dispatch();
+		void Resize(uint32_t width, uint32_t height);
+
+		void SaveImage(std::string file_name);
+		bool IsSaving();
+
+		bool Resume(std::string file_name);
+		void SetCheckpoint(std::string file_name, float interval_seconds);
+		uint32_t GetSampleCount();
+		void SetSampleOffset(uint32_t sample_offset);
+		void SetPreviewScale(uint32_t scale);
+		void SetQuality(Quality quality);
+		static bool ParseQuality(std::string name, Quality & quality);
+		static uint32_t GetMaxSamples(Quality quality);
+		void SetSampleBudget(float milliseconds);
+		void SetSampleLimit(uint32_t samples);
+		void SetWavefront(bool enabled);
+		void SetPersistentGroups(uint32_t groups);
+		void ReloadPipelines();
+		void SetPackedScene(bool enabled);
+		int LoadTexture(std::string file_name);
+
+		bool RenderTiles(std::string file_name, uint32_t image_width, uint32_t image_height, uint32_t samples, uint32_t worker_index = 0, uint32_t worker_count = 0);
+		bool IsFinished();
 };
 
@@ -0,0 +1,127 @@
+#include "PipelineCache.h"
+#include "Checkpoint.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+static const char PIPELINE_CACHE_MAGIC[8] = { 'A', 'V', 'K', 'P', 'C', 'A', 'C', 0 };
+
+PipelineCache::PipelineCache( Renderer * renderer, std::string file_prefix )
+{
+	_renderer = renderer;
+
+	// workers on different gpus share the directory, each model keeps its own file.
+	VkPhysicalDeviceProperties properties = renderer->GetGPUProperties();
+	std::stringstream name;
+	name << file_prefix << "_" << std::hex << std::setfill( '0' ) << std::setw( 4 ) << properties.vendorID << "_" << std::setw( 4 ) << properties.deviceID << ".cache";
+	_file_name = name.str();
+
+	std::vector<char> data = _Load();
+	_loaded = !data.empty();
+
+	VkPipelineCacheCreateInfo create_info = Structs::PipelineCacheCreateInfo();
+	create_info.initialDataSize	= data.size();
+	create_info.pInitialData	= data.empty() ? nullptr : data.data();
+
+	ErrorCheck( vkCreatePipelineCache( renderer->GetDevice(), &create_info, nullptr, &_cache ),
+				"Unable to create pipeline cache.", _loaded ? "Pipeline cache loaded from \"" + _file_name + "\"." : "Pipeline cache has been created." );
+}
+
+PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache( _renderer->GetDevice(), _cache, nullptr );
+}
+
+
+PipelineCache::Header PipelineCache::_DeviceHeader()
+{
+	VkPhysicalDeviceProperties properties = _renderer->GetGPUProperties();
+
+	Header header = {};
+	memcpy( header.magic, PIPELINE_CACHE_MAGIC, sizeof(PIPELINE_CACHE_MAGIC) );
+	header.version			= VERSION;
+	header.vendor_id		= properties.vendorID;
+	header.device_id		= properties.deviceID;
+	header.driver_version	= properties.driverVersion;
+	memcpy( header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE );
+
+	return header;
+}
+
+// empty when there is no file, or it was written by another device or driver.
+std::vector<char> PipelineCache::_Load()
+{
+	std::ifstream file( _file_name, std::ios::binary );
+	if ( file.fail() )
+		return std::vector<char>();
+
+	Header header	= {};
+	Header device	= _DeviceHeader();
+	if ( !file.read( reinterpret_cast<char*>( &header ), sizeof(Header) ) ||
+		 memcmp( header.magic, device.magic, sizeof(header.magic) ) != 0 || header.version != VERSION ) {
+		std::cout << "Pipeline cache \"" << _file_name << "\" is not valid, rebuilding." << std::endl;
+		return std::vector<char>();
+	}
+
+	if ( header.vendor_id != device.vendor_id || header.device_id != device.device_id ||
+		 header.driver_version != device.driver_version || memcmp( header.uuid, device.uuid, VK_UUID_SIZE ) != 0 ) {
+		std::cout << "Pipeline cache \"" << _file_name << "\" belongs to another driver, rebuilding." << std::endl;
+		return std::vector<char>();
+	}
+
+	std::vector<char> data( (size_t)header.data_size );
+	if ( data.empty() || !file.read( data.data(), data.size() ) || Checkpoint::Hash( data.data(), data.size() ) != header.data_hash ) {
+		std::cout << "Pipeline cache \"" << _file_name << "\" is truncated, rebuilding." << std::endl;
+		return std::vector<char>();
+	}
+
+	return data;
+}
+
+
+VkPipelineCache PipelineCache::GetCache()
+{
+	return _cache;
+}
+
+// true when the pipelines could be built from the file.
+bool PipelineCache::IsLoaded()
+{
+	return _loaded;
+}
+
+bool PipelineCache::Save()
+{
+	size_t size = 0;
+	if ( vkGetPipelineCacheData( _renderer->GetDevice(), _cache, &size, nullptr ) != VK_SUCCESS || size == 0 )
+		return false;
+
+	std::vector<char> data( size );
+	if ( vkGetPipelineCacheData( _renderer->GetDevice(), _cache, &size, data.data() ) != VK_SUCCESS )
+		return false;
+	data.resize( size );
+
+	Header header		= _DeviceHeader();
+	header.data_size	= data.size();
+	header.data_hash	= Checkpoint::Hash( data.data(), data.size() );
+
+	std::string temp_file_name = _file_name + "." + std::to_string( GetCurrentProcessId() ) + ".tmp";
+	bool success;
+	{
+		std::ofstream file( temp_file_name, std::ios::binary | std::ios::trunc );
+		file.write( reinterpret_cast<const char*>( &header ), sizeof(Header) );
+		file.write( data.data(), data.size() );
+		success = file.good();
+	}
+
+	success = success && MoveFileExA( temp_file_name.c_str(), _file_name.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+	if ( !success ) {
+		DeleteFileA( temp_file_name.c_str() );
+		std::cout << "Could not write pipeline cache \"" << _file_name << "\"!" << std::endl;
+	}
+
+	return success;
+}
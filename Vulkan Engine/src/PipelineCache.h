@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Platform.h"
+#include "Renderer.h"
+
+// VkPipelineCache kept on disk between launches, one file per gpu model.
+// The header pins the device, its pipelineCacheUUID and the driver version; a cache of any other driver is dropped and rebuilt.
+// Saved to a temporary file per process and renamed, so concurrent workers never read a torn cache.
+class PipelineCache
+{
+	public:
+		static const uint32_t				VERSION					= 1;
+
+		struct Header
+		{
+			char							magic[8];
+			uint32_t						version;
+			uint32_t						vendor_id;
+			uint32_t						device_id;
+			uint32_t						driver_version;
+			uint8_t							uuid[VK_UUID_SIZE];
+			uint64_t						data_size;
+			uint64_t						data_hash;
+		};
+
+	private:
+		Renderer				*			_renderer				= nullptr;
+		std::string							_file_name;
+		VkPipelineCache						_cache					= VK_NULL_HANDLE;
+		bool								_loaded					= false;
+
+		Header								_DeviceHeader();
+		std::vector<char>					_Load();
+
+	public:
+		PipelineCache( Renderer * renderer, std::string file_prefix );
+		~PipelineCache();
+
+		VkPipelineCache						GetCache();
+		bool								IsLoaded();
+		bool								Save();
+};
@@ -0,0 +1,188 @@
+#include "Readback.h"
+
+Readback::Readback( Renderer * renderer, uint32_t width, uint32_t height, uint32_t texel_size, uint32_t slot_count )
+{
+	_renderer		= renderer;
+	_width			= width;
+	_height			= height;
+	_size			= (VkDeviceSize)width * height * texel_size;
+	_worker			= new Worker();
+
+	VkCommandPoolCreateInfo create_info = Structs::CommandPoolCreateInfo( _renderer->GetComputeFamilyIndex() );
+	create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	ErrorCheck( vkCreateCommandPool( _renderer->GetDevice(), &create_info, nullptr, &_command_pool ),
+		"Unable to create a readback command pool.", "Readback command pool created." );
+
+	for ( uint32_t i = 0; i < slot_count; i++ )
+	{
+		Slot * slot = new Slot();
+		slot->state = SLOT_FREE;
+		_CreateSlot( slot );
+		_slots.push_back( slot );
+	}
+}
+
+Readback::~Readback()
+{
+	Flush();
+
+	for ( Slot * slot : _slots )
+	{
+		vkDestroyBuffer( _renderer->GetDevice(), slot->buffer, nullptr );
+		_renderer->GetAllocator()->Free( slot->allocation );
+		vkDestroyFence( _renderer->GetDevice(), slot->fence, nullptr );
+		delete slot;
+	}
+
+	vkDestroyCommandPool( _renderer->GetDevice(), _command_pool, nullptr );
+	delete _worker;
+}
+
+
+bool Readback::IsAvailable()
+{
+	for ( Slot * slot : _slots )
+		if ( slot->state == SLOT_FREE )
+			return true;
+	return false;
+}
+
+bool Readback::IsIdle()
+{
+	for ( Slot * slot : _slots )
+		if ( slot->state != SLOT_FREE )
+			return false;
+	return true;
+}
+
+bool Readback::Capture( VkQueue queue, VkImage image, VkImageLayout layout, VkSemaphore signal_semaphore, Consumer consumer )
+{
+	Slot * slot = nullptr;
+	for ( Slot * s : _slots )
+	{
+		if ( s->state == SLOT_FREE ) {
+			slot = s;
+			break;
+		}
+	}
+
+	// ring is full, drop the capture instead of stalling the frame.
+	if ( slot == nullptr )
+		return false;
+
+	_RecordCopy( slot, image, layout );
+
+	slot->consumer = consumer;
+	slot->state    = SLOT_COPYING;
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType					= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount		= 1;
+	submit_info.pCommandBuffers			= &slot->command_buffer;
+	submit_info.signalSemaphoreCount	= signal_semaphore != VK_NULL_HANDLE ? 1 : 0;
+	submit_info.pSignalSemaphores		= &signal_semaphore;
+
+	vkResetFences( _renderer->GetDevice(), 1, &slot->fence );
+	ErrorCheck( vkQueueSubmit( queue, 1, &submit_info, slot->fence ), "Unable to submit readback copy." );
+
+	return true;
+}
+
+void Readback::Poll()
+{
+	for ( Slot * slot : _slots )
+	{
+		if ( slot->state != SLOT_COPYING )
+			continue;
+
+		// non blocking, copy is picked up on a later frame if it isn't done yet.
+		if ( vkGetFenceStatus( _renderer->GetDevice(), slot->fence ) != VK_SUCCESS )
+			continue;
+
+		// nothing to do for coherent memory.
+		_renderer->GetAllocator()->Invalidate( slot->allocation );
+
+		slot->state = SLOT_CONSUMING;
+
+		uint32_t width  = _width;
+		uint32_t height = _height;
+		_worker->Push( [slot, width, height] {
+			slot->consumer( slot->allocation.mapped, width, height );
+			slot->consumer = nullptr;
+			slot->state    = SLOT_FREE;
+		} );
+	}
+}
+
+void Readback::Flush()
+{
+	for ( Slot * slot : _slots )
+		if ( slot->state == SLOT_COPYING )
+			vkWaitForFences( _renderer->GetDevice(), 1, &slot->fence, VK_TRUE, UINT64_MAX );
+
+	Poll();
+	_worker->Wait();
+}
+
+
+void Readback::_CreateSlot( Slot * slot )
+{
+	VkBufferCreateInfo buffer_create_info = Structs::BufferCreateInfo( VK_BUFFER_USAGE_TRANSFER_DST_BIT, _size );
+	ErrorCheck( vkCreateBuffer( _renderer->GetDevice(), &buffer_create_info, nullptr, &slot->buffer ), "Unable to create readback buffer." );
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements( _renderer->GetDevice(), slot->buffer, &memory_requirements );
+
+	// cached memory makes cpu reads fast, but might not be coherent.
+	VkBool32 found = false;
+	uint32_t memory_type = _renderer->GetGPUMemoryType( memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &found );
+	if ( !found )
+		memory_type = _renderer->GetGPUMemoryType( memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &found );
+	if ( !found )
+		memory_type = _renderer->GetGPUMemoryType( memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+	// stays mapped for the lifetime of the ring.
+	slot->allocation = _renderer->GetAllocator()->Allocate( memory_requirements, memory_type, MemoryAllocator::LINEAR, MemoryAllocator::STAGING );
+	ErrorCheck( vkBindBufferMemory( _renderer->GetDevice(), slot->buffer, slot->allocation.memory, slot->allocation.offset ), "Unable to bind readback memory." );
+
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _command_pool, 1 );
+	ErrorCheck( vkAllocateCommandBuffers( _renderer->GetDevice(), &allocate_info, &slot->command_buffer ), "Unable to allocate readback command buffer." );
+
+	VkFenceCreateInfo fence_create_info = Structs::FenceCreateInfo();
+	ErrorCheck( vkCreateFence( _renderer->GetDevice(), &fence_create_info, nullptr, &slot->fence ), "Unable to create readback fence." );
+}
+
+void Readback::_RecordCopy( Slot * slot, VkImage image, VkImageLayout layout )
+{
+	VkCommandBufferBeginInfo begin_info = Structs::CommandBufferBeginInfo();
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	ErrorCheck( vkBeginCommandBuffer( slot->command_buffer, &begin_info ), "Unable to begin readback command buffer." );
+
+	// wait for the shader writes before copying.
+	VkMemoryBarrier barrier_shader_to_transfer = {};
+	barrier_shader_to_transfer.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier_shader_to_transfer.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+	barrier_shader_to_transfer.dstAccessMask	= VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier( slot->command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier_shader_to_transfer, 0, nullptr, 0, nullptr );
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset						= 0;
+	region.bufferRowLength					= 0;
+	region.bufferImageHeight				= 0;
+	region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel		= 0;
+	region.imageSubresource.baseArrayLayer	= 0;
+	region.imageSubresource.layerCount		= 1;
+	region.imageOffset						= { 0, 0, 0 };
+	region.imageExtent						= { _width, _height, 1 };
+	vkCmdCopyImageToBuffer( slot->command_buffer, image, layout, slot->buffer, 1, &region );
+
+	// make the copy visible to the host, and keep later shader writes from overtaking the copy.
+	VkMemoryBarrier barrier_transfer_to_host = {};
+	barrier_transfer_to_host.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier_transfer_to_host.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier_transfer_to_host.dstAccessMask	= VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier( slot->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier_transfer_to_host, 0, nullptr, 0, nullptr );
+
+	ErrorCheck( vkEndCommandBuffer( slot->command_buffer ), "Unable to record readback command buffer." );
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include "Platform.h"
+#include "Shared.h"
+#include "Renderer.h"
+#include "base\Worker.h"
+#include "base\MemoryAllocator.h"
+#include "base\helpers\Structs.h"
+
+// Copies an image into a ring of host visible staging buffers.
+// Finished copies are handed to a background worker, the render loop never waits for the copy fence or the disk.
+class Readback
+{
+	public:
+		typedef std::function<void( const void * data, uint32_t width, uint32_t height )>	Consumer;
+
+	private:
+		enum SlotState { SLOT_FREE, SLOT_COPYING, SLOT_CONSUMING };
+
+		struct Slot
+		{
+			VkBuffer						buffer					= VK_NULL_HANDLE;
+			MemoryAllocator::Allocation		allocation;
+			VkCommandBuffer					command_buffer			= VK_NULL_HANDLE;
+			VkFence							fence					= VK_NULL_HANDLE;
+			Consumer						consumer;
+			std::atomic<int>				state;
+		};
+
+		Renderer				*			_renderer				= nullptr;
+		Worker					*			_worker					= nullptr;
+
+		uint32_t							_width					= 0;
+		uint32_t							_height					= 0;
+		VkDeviceSize						_size					= 0;
+
+		VkCommandPool						_command_pool			= VK_NULL_HANDLE;
+		std::vector<Slot*>					_slots;
+
+		void								_CreateSlot( Slot * slot );
+		void								_RecordCopy( Slot * slot, VkImage image, VkImageLayout layout );
+
+	public:
+		Readback( Renderer * renderer, uint32_t width, uint32_t height, uint32_t texel_size, uint32_t slot_count = 2 );
+		~Readback();
+
+		bool								IsAvailable();
+		bool								IsIdle();
+
+		bool								Capture( VkQueue queue, VkImage image, VkImageLayout layout, VkSemaphore signal_semaphore, Consumer consumer );
+		void								Poll();
+		void								Flush();
+};
@@ -1,16 +1,22 @@
 #include "Renderer.h"
 #include "Shared.h"
+#include "base\MemoryAllocator.h"
+#include "BUILD_OPTIONS.h"
 
 #include <iostream>
+#include <iomanip>
 #include <cstdlib>
+#include <cstring>
 #include <assert.h>
 #include <vector>
 #include <sstream>
 
 
 
-Renderer::Renderer()
+Renderer::Renderer( uint32_t gpu_index )
 {
+	_gpu_index = gpu_index;
+
 	std::cout << "-------------------------------------- Creating Renderer -----------------------------------" << std::endl;
 
 	_SetupLayersAndExtensions();
@@ -20,13 +26,16 @@ Renderer::Renderer()
 	_InitDevice();
 }
 
+// in reverse order of creation, nothing may be in flight once objects get destroyed.
 Renderer::~Renderer()
 {
+	vkDeviceWaitIdle( _device );
+
 	delete _window;
 
-	_DeInitInstance();
-	_DeInitDebug();
 	_DeInitDevice();
+	_DeInitDebug();
+	_DeInitInstance();
 }
 
 
@@ -66,6 +75,17 @@ VkQueue  Renderer::GetComputeQueue()
 	return _compute_queue;
 }
 
+uint32_t Renderer::GetTransferFamilyIndex()
+{
+	return _transfer_family_index;
+}
+
+// the compute queue when the gpu has no dedicated copy family.
+VkQueue  Renderer::GetTransferQueue()
+{
+	return _transfer_queue;
+}
+
 VkPhysicalDeviceProperties Renderer::GetGPUProperties()
 {
 	return _gpu_properties;
@@ -102,6 +122,73 @@ uint32_t Renderer::GetGPUMemoryType(uint32_t typeBits, VkMemoryPropertyFlags pro
 	}
 }
 
+// true when sampled images can be indexed per invocation from a partially written array, see GetMaxBindlessTextures().
+bool Renderer::SupportsDescriptorIndexing()
+{
+	return _descriptor_indexing;
+}
+
+uint32_t Renderer::GetMaxBindlessTextures()
+{
+	return _max_bindless_textures;
+}
+
+// buffers, images and anything else frames may still use are destroyed through it, see DeletionQueue.
+DeletionQueue * Renderer::GetDeletionQueue()
+{
+	return _deletion_queue;
+}
+
+// every buffer and image binds into memory of this allocator, created with the device.
+MemoryAllocator * Renderer::GetAllocator()
+{
+	return _allocator;
+}
+
+// every heap with memory in it, live, budgets are queried again on every call.
+std::vector<Renderer::MemoryReport> Renderer::GetMemoryReport()
+{
+	VkDeviceSize usage[VK_MAX_MEMORY_HEAPS]		= {};
+	VkDeviceSize budget[VK_MAX_MEMORY_HEAPS]	= {};
+	bool from_driver = _QueryMemoryBudget(usage, budget);
+	_UpdateMemoryBudget();
+
+	std::vector<MemoryReport> report;
+	for (uint32_t i = 0; i < _memory_properties.memoryHeapCount; i++)
+	{
+		MemoryReport heap;
+		heap.heap	= i;
+		heap.flags	= _memory_properties.memoryHeaps[i].flags;
+		heap.size	= _memory_properties.memoryHeaps[i].size;
+		heap.engine	= _allocator->GetHeapStatistics(i);
+		heap.budget	= from_driver ? budget[i] : heap.engine.budget;
+		heap.usage	= from_driver ? usage[i] : heap.engine.allocated;
+		report.push_back(heap);
+	}
+	return report;
+}
+
+void Renderer::PrintMemoryReport()
+{
+	std::cout << "-------------------------------------- GPU Memory -----------------------------------" << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+
+	for (MemoryReport & heap : GetMemoryReport())
+	{
+		std::cout << "heap " << heap.heap << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " device local" : " host")
+			<< ": " << heap.usage / 1048576.0 << " of " << heap.budget / 1048576.0 << " MB budget" << (_memory_budget ? "" : " ( estimated )")
+			<< ", " << heap.size / 1048576.0 << " MB heap" << std::endl;
+
+		for (uint32_t i = 0; i < MemoryAllocator::CATEGORY_COUNT; i++)
+		{
+			if (heap.engine.categories[i] > 0)
+				std::cout << "    " << MemoryAllocator::GetCategoryName((MemoryAllocator::Category)i) << ": " << heap.engine.categories[i] / 1048576.0 << " MB" << std::endl;
+		}
+	}
+
+	_allocator->PrintStatistics();
+}
+
 Window * Renderer::GetWindow()
 {
 	return _window;
@@ -163,8 +250,8 @@ void Renderer::_InitDevice()
 		if ( gpu_count == 0 )
 			assert(-1 && "Vulkan ERROR: gpu not found.");
 
-		// assing first found gpu
-		_gpu = gpuList[0];
+		// assing requested gpu, first found one if there is no such gpu
+		_gpu = gpuList[ _gpu_index < gpu_count ? _gpu_index : 0 ];
 
 		// extract gpu properties
 		// can be used to exctract gpu name, vendor etc.
@@ -218,6 +305,18 @@ void Renderer::_InitDevice()
 			assert(1 && "Vulkan ERROR: queue family supporting compute not found.");
 			std::exit(-1);
 		}
+
+		// search for a transfer only family, its copies run beside the compute queue.
+		_transfer_family_index = _compute_family_index;
+		for (uint32_t i = 0; i < family_count; ++i) {
+			VkQueueFlags flags = family_property_list[i].queueFlags;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				_transfer_family_index = i;
+				break;
+			}
+		}
+
+		std::cout << " - Selected GPU Transfer Queue Family: " << _transfer_family_index << ( _transfer_family_index == _compute_family_index ? " ( shared with compute )" : " ( dedicated )" ) << std::endl;
 	}
 
 	// extract available instance layers
@@ -259,7 +358,8 @@ void Renderer::_InitDevice()
 	// set priorities to queues if both have work.
 	float queue_priorities[] { 1.0f };
 	float queue_priorities2[]{ 0.9f };
-	VkDeviceQueueCreateInfo device_queues[2];
+	float queue_priorities3[]{ 0.5f };
+	VkDeviceQueueCreateInfo device_queues[3];
 
 	VkDeviceQueueCreateInfo graphics_queue_create_info {};
 	graphics_queue_create_info.sType			= VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -275,30 +375,99 @@ void Renderer::_InitDevice()
 	compute_queue_create_info.pQueuePriorities	= queue_priorities2;
 	device_queues[1] = compute_queue_create_info;
 
+	VkDeviceQueueCreateInfo transfer_queue_create_info{};
+	transfer_queue_create_info.sType			= VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	transfer_queue_create_info.queueFamilyIndex	= _transfer_family_index;
+	transfer_queue_create_info.queueCount		= 1;
+	transfer_queue_create_info.pQueuePriorities	= queue_priorities3;
+	device_queues[2] = transfer_queue_create_info;
+
 	// create device info structure
 	VkDeviceCreateInfo device_create_info {};
 	device_create_info.sType					= VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	device_create_info.queueCreateInfoCount		= 2;
+	device_create_info.queueCreateInfoCount		= _transfer_family_index != _compute_family_index ? 3 : 2;
 	device_create_info.pQueueCreateInfos		= device_queues;
 
-	// layers & extensions for debugging.
+	// heap budgets of the whole process and bindless textures, both need the properties2 instance extension.
+#ifdef VK_EXT_descriptor_indexing
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features {};
+	indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+#endif
+	if (_properties2)
+	{
+		uint32_t extension_count = 0;
+		vkEnumerateDeviceExtensionProperties( _gpu, nullptr, &extension_count, nullptr );
+		std::vector<VkExtensionProperties> extension_list( extension_count );
+		vkEnumerateDeviceExtensionProperties( _gpu, nullptr, &extension_count, extension_list.data() );
+
+#ifdef VK_EXT_memory_budget
+		for (auto &i : extension_list)
+			_memory_budget |= strcmp( i.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME ) == 0;
+		if (_memory_budget)
+			_device_extensions.push_back( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME );
+#endif
+
+#ifdef VK_EXT_descriptor_indexing
+		bool maintenance3 = false;
+		for (auto &i : extension_list)
+		{
+			_descriptor_indexing	|= strcmp( i.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME ) == 0;
+			maintenance3			|= strcmp( i.extensionName, VK_KHR_MAINTENANCE3_EXTENSION_NAME ) == 0;
+		}
+		if (_descriptor_indexing && maintenance3)
+			_InitDescriptorIndexing( &indexing_features );
+		else
+			_descriptor_indexing = false;
+
+		// only what a large, partially written array of textures indexed per ray needs.
+		if (_descriptor_indexing)
+		{
+			_device_extensions.push_back( VK_KHR_MAINTENANCE3_EXTENSION_NAME );
+			_device_extensions.push_back( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+			device_create_info.pNext = &indexing_features;
+		}
+#endif
+	}
+	std::cout << " - Material Textures: " << ( _descriptor_indexing ? "VK_EXT_descriptor_indexing" : "fixed texture array" ) << std::endl;
+
+	// layers & extensions for debugging, and the optional ones found above.
 	device_create_info.enabledLayerCount		= (uint32_t)_device_layers.size();
 	device_create_info.ppEnabledLayerNames		= _device_layers.data();
 	device_create_info.enabledExtensionCount	= (uint32_t)_device_extensions.size();
 	device_create_info.ppEnabledExtensionNames	= _device_extensions.data();
 
+	// block compressed textures when the gpu samples them, nothing else is needed.
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures( _gpu, &supported_features );
+	VkPhysicalDeviceFeatures enabled_features {};
+	enabled_features.textureCompressionBC		= supported_features.textureCompressionBC;
+	device_create_info.pEnabledFeatures			= &enabled_features;
+
 	// assign gpu to vulkan device.
 	ErrorCheck( vkCreateDevice( _gpu, &device_create_info, nullptr, &_device), "Failed initializing vulkan device.", "Vulkan device initialized." );
 
-	// get both queues.
+	// get all queues.
 	vkGetDeviceQueue( _device, _graphics_family_index, 0, &_queue );
 	vkGetDeviceQueue( _device, _compute_family_index, 0, &_compute_queue );
+	vkGetDeviceQueue( _device, _transfer_family_index, 0, &_transfer_queue );
+
+	_allocator = new MemoryAllocator( _device, _gpu );
+	_deletion_queue = new DeletionQueue( BUILD_FRAMES_IN_FLIGHT );
+
+#ifdef VK_EXT_memory_budget
+	fvkGetPhysicalDeviceMemoryProperties2KHR = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr( _instance, "vkGetPhysicalDeviceMemoryProperties2KHR" );
+	_memory_budget = _memory_budget && fvkGetPhysicalDeviceMemoryProperties2KHR != nullptr;
+#endif
+	std::cout << " - Memory Budget: " << ( _memory_budget ? "VK_EXT_memory_budget" : "estimated from heap sizes" ) << std::endl;
+	_UpdateMemoryBudget();
 }
 
 void Renderer::_DeInitDevice()
 {
 	// automatically manage memory while destroying the device.
 	// returns no errors.
+	delete _deletion_queue;
+	delete _allocator;
 	vkDestroyDevice( _device, nullptr );
 }
 
@@ -334,6 +503,10 @@ void Renderer::_SetupDebug()
 	//_device_layers.push_back( "VK_LAYER_LUNARG_param_checker" );
 }
 
+#ifdef VK_EXT_memory_budget
+PFN_vkGetPhysicalDeviceMemoryProperties2KHR	fvkGetPhysicalDeviceMemoryProperties2KHR	= nullptr;
+#endif
+
 // debug callback.
 PFN_vkCreateDebugReportCallbackEXT			fvkCreateDebugReportCallbackEXT				= nullptr;
 PFN_vkDestroyDebugReportCallbackEXT			fvkDestroyDebugReportCallbackEXT			= nullptr;
@@ -419,6 +592,107 @@ void Renderer::_SetupLayersAndExtensions()
 	_instance_extensions.push_back( VK_KHR_WIN32_SURFACE_EXTENSION_NAME );
 	
 	_device_extensions.push_back( VK_KHR_SWAPCHAIN_EXTENSION_NAME );
+
+	// memory budgets and descriptor indexing limits are queried through the properties2 functions, when the loader has them.
+#ifdef VK_KHR_get_physical_device_properties2
+	uint32_t extension_count = 0;
+	vkEnumerateInstanceExtensionProperties( nullptr, &extension_count, nullptr );
+	std::vector<VkExtensionProperties> extension_list( extension_count );
+	vkEnumerateInstanceExtensionProperties( nullptr, &extension_count, extension_list.data() );
+
+	for (auto &i : extension_list)
+		_properties2 |= strcmp( i.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME ) == 0;
+	if (_properties2)
+		_instance_extensions.push_back( VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME );
+#endif
+}
+
+#ifdef VK_EXT_descriptor_indexing
+// keeps descriptor indexing when the features bindless textures need are there, and sizes their array.
+void Renderer::_InitDescriptorIndexing( VkPhysicalDeviceDescriptorIndexingFeaturesEXT * enabled_features )
+{
+	PFN_vkGetPhysicalDeviceFeatures2KHR fvkGetPhysicalDeviceFeatures2KHR = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr( _instance, "vkGetPhysicalDeviceFeatures2KHR" );
+	PFN_vkGetPhysicalDeviceProperties2KHR fvkGetPhysicalDeviceProperties2KHR = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr( _instance, "vkGetPhysicalDeviceProperties2KHR" );
+	if (fvkGetPhysicalDeviceFeatures2KHR == nullptr || fvkGetPhysicalDeviceProperties2KHR == nullptr)
+	{
+		_descriptor_indexing = false;
+		return;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2KHR features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+	features.pNext = &supported;
+	fvkGetPhysicalDeviceFeatures2KHR( _gpu, &features );
+
+	_descriptor_indexing =	supported.runtimeDescriptorArray && supported.shaderSampledImageArrayNonUniformIndexing &&
+							supported.descriptorBindingPartiallyBound && supported.descriptorBindingSampledImageUpdateAfterBind;
+	if (!_descriptor_indexing)
+		return;
+
+	enabled_features->runtimeDescriptorArray						= VK_TRUE;
+	enabled_features->shaderSampledImageArrayNonUniformIndexing		= VK_TRUE;
+	enabled_features->descriptorBindingPartiallyBound				= VK_TRUE;
+	enabled_features->descriptorBindingSampledImageUpdateAfterBind	= VK_TRUE;
+
+	// combined image samplers count as samplers and sampled images.
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits {};
+	limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2KHR properties {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties.pNext = &limits;
+	fvkGetPhysicalDeviceProperties2KHR( _gpu, &properties );
+
+	uint32_t count = BUILD_BINDLESS_TEXTURES;
+	uint32_t caps[] = { limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+						limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers };
+	for (uint32_t cap : caps)
+		count = cap < count ? cap : count;
+	_max_bindless_textures = count;
+}
+#endif
+
+// heap usage and budget of the whole process from the driver, false without VK_EXT_memory_budget.
+bool Renderer::_QueryMemoryBudget(VkDeviceSize * usage, VkDeviceSize * budget)
+{
+#ifdef VK_EXT_memory_budget
+	if (!_memory_budget)
+		return false;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties {};
+	budget_properties.sType		= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR memory_properties {};
+	memory_properties.sType		= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memory_properties.pNext		= &budget_properties;
+	fvkGetPhysicalDeviceMemoryProperties2KHR( _gpu, &memory_properties );
+
+	for (uint32_t i = 0; i < _memory_properties.memoryHeapCount; i++)
+	{
+		usage[i]	= budget_properties.heapUsage[i];
+		budget[i]	= budget_properties.heapBudget[i];
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+// the allocator gets what is left of each budget after other processes, and what of ours it can't see.
+void Renderer::_UpdateMemoryBudget()
+{
+	VkDeviceSize usage[VK_MAX_MEMORY_HEAPS]		= {};
+	VkDeviceSize budget[VK_MAX_MEMORY_HEAPS]	= {};
+	if (!_QueryMemoryBudget(usage, budget))
+		return;
+
+	for (uint32_t i = 0; i < _memory_properties.memoryHeapCount; i++)
+	{
+		VkDeviceSize allocated	= _allocator->GetHeapStatistics(i).allocated;
+		VkDeviceSize others		= usage[i] > allocated ? usage[i] - allocated : 0;
+		_allocator->SetBudget(i, budget[i] > others ? budget[i] - others : 0);
+	}
 }
 
 Window * Renderer::OpenWindow(uint32_t size_x, uint32_t size_y, std::string name)
@@ -429,6 +703,10 @@ Window * Renderer::OpenWindow(uint32_t size_x, uint32_t size_y, std::string name
 
 bool Renderer::Run()
 {
+	// other processes come and go, a few times a second is plenty.
+	if (++_budget_frame % 64 == 0)
+		_UpdateMemoryBudget();
+
 	if (nullptr != _window)
 		return _window->Update();
 	return true;
@@ -3,8 +3,11 @@
 #include <vector>
 #include "Platform.h"
 #include "Window.h"
+#include "base\MemoryAllocator.h"
+#include "base\DeletionQueue.h"
 
 class Window;
+class MemoryAllocator;
 class Renderer
 {
 private:
@@ -14,11 +17,14 @@ private:
 	VkDevice							_device							= VK_NULL_HANDLE;
 	VkQueue								_queue							= VK_NULL_HANDLE;
 	VkQueue								_compute_queue					= VK_NULL_HANDLE;
+	VkQueue								_transfer_queue					= VK_NULL_HANDLE;
 	VkPhysicalDeviceProperties			_gpu_properties					= {};
 	VkPhysicalDeviceMemoryProperties	_memory_properties				= {};
 
 	uint32_t							_graphics_family_index			= 0;
 	uint32_t							_compute_family_index			= 0;
+	uint32_t							_transfer_family_index			= 0;
+	uint32_t							_gpu_index						= 0;
 
 	std::vector<const char*>			_instance_layers;
 	std::vector<const char*>			_instance_extensions;
@@ -28,10 +34,28 @@ private:
 
 	VkDebugReportCallbackEXT			_debug_report					= VK_NULL_HANDLE;
 
-	Window					*			_window;
-public:
+	MemoryAllocator			*			_allocator						= nullptr;
+	DeletionQueue			*			_deletion_queue					= nullptr;
+	bool								_properties2					= false;
+	bool								_memory_budget					= false;
+	bool								_descriptor_indexing			= false;
+	uint32_t							_max_bindless_textures			= 0;
+	uint32_t							_budget_frame					= 0;
 
-	Renderer();
+	Window					*			_window							= nullptr;
+public:
+	// a heap as the driver and the engine see it.
+	struct MemoryReport
+	{
+		uint32_t							heap;
+		VkMemoryHeapFlags					flags;
+		VkDeviceSize						size;
+		VkDeviceSize						budget;					// what the process may use before the driver starts paging
+		VkDeviceSize						usage;					// of the whole process, the engine's own without VK_EXT_memory_budget
+		MemoryAllocator::HeapStatistics		engine;
+	};
+
+	Renderer( uint32_t gpu_index = 0 );
 	~Renderer();
 
 	VkDevice							GetDevice();
@@ -39,10 +63,18 @@ public:
 	VkInstance							GetInstance();
 	uint32_t							GetGraphicsFamilyIndex();
 	uint32_t							GetComputeFamilyIndex();
+	uint32_t							GetTransferFamilyIndex();
 	VkQueue								GetQueue();
 	VkQueue								GetComputeQueue();
+	VkQueue								GetTransferQueue();
 	VkPhysicalDeviceProperties			GetGPUProperties();
 	uint32_t							GetGPUMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr);
+	MemoryAllocator			*			GetAllocator();
+	DeletionQueue			*			GetDeletionQueue();
+	bool								SupportsDescriptorIndexing();
+	uint32_t							GetMaxBindlessTextures();
+	std::vector<MemoryReport>			GetMemoryReport();
+	void								PrintMemoryReport();
 	
 
 	Window					*		OpenWindow(uint32_t size_x, uint32_t size_y, std::string name);
@@ -62,5 +94,11 @@ private:
 	void _DeInitDebug();
 
 	void _SetupLayersAndExtensions();
+
+#ifdef VK_EXT_descriptor_indexing
+	void _InitDescriptorIndexing(VkPhysicalDeviceDescriptorIndexingFeaturesEXT * enabled_features);
+#endif
+	bool _QueryMemoryBudget(VkDeviceSize * usage, VkDeviceSize * budget);
+	void _UpdateMemoryBudget();
 };
 
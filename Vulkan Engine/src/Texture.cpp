@@ -1,70 +1,52 @@
 #include "Texture.h"
-#include <fstream>
 #include <iostream>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb-master\stb-master\stb_image.h>
-
-Texture::Texture(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, std::vector<char> texture_data, VkImageAspectFlagBits aspectMask)
+Texture::Texture(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, uint32_t mip_levels, VkImageAspectFlagBits aspectMask, VkImageUsageFlags usage, bool concurrent)
 {
-	_CreateImage(renderer, width, height, format);
+	_device = renderer->GetDevice();
+	_allocator = renderer->GetAllocator();
+	_deletion_queue = renderer->GetDeletionQueue();
+	_width = width;
+	_height = height;
+	_format = format;
+	_mip_levels = mip_levels;
+	_usage = usage;
+
+	_CreateImage(renderer, width, height, format, usage, concurrent);
 	_CreateImageMemory(renderer);
 	_CreateImageView(renderer, format, aspectMask);
 	_CreateSampler(renderer);
 	_CreateImageDescriptor();
-
-	/*if (texture_data.size() == 0)	return;
-	_CopyTextureData(renderer, texture_data, width, height);
-	*/
 }
 
+// frames in flight may still sample or write the image, it goes once they retired.
 Texture::~Texture()
 {
-	// destroy image
-	// destroy image view.
+	VkDevice device = _device;
+	MemoryAllocator * allocator = _allocator;
+	VkSampler sampler = _sampler;
+	VkImageView image_view = _image_view;
+	VkImage image = _image;
+	MemoryAllocator::Allocation allocation = _allocation;
+
+	_deletion_queue->Push([=]() mutable
+	{
+		vkDestroySampler(device, sampler, nullptr);
+		vkDestroyImageView(device, image_view, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		allocator->Free(allocation);
+	});
 }
 
 
 
-Texture * Texture::Load(Renderer * renderer, std::string file_name)
+// full chain down to 1x1.
+uint32_t Texture::GetMipCount(uint32_t width, uint32_t height)
 {
-	// get binary file contents
-	std::ifstream file(file_name, std::ios::binary);
-	if (file.fail()) {
-		std::cout << "Could not open \"" << file_name << "\" file!" << std::endl;
-		return nullptr;
-	}
-
-	std::streampos begin, end;
-	begin = file.tellg();
-	file.seekg(0, std::ios::end);
-	end = file.tellg();
-
-	std::vector<char> file_data(static_cast<size_t>(end - begin));
-	file.seekg(0, std::ios::beg);
-	file.read(&file_data[0], end - begin);
-	file.close();
-
-	// get image data.
-	int width = 0, height = 0, components = 0, requested_components = 4;
-	unsigned char *image_data = stbi_load_from_memory(reinterpret_cast<unsigned char*>(&file_data[0]), static_cast<int>(file_data.size()), &width, &height, &components, requested_components);
-
-	if ((image_data == nullptr) ||
-		(width <= 0) ||
-		(height <= 0) ||
-		(components <= 0)) {
-		std::cout << "Could not read image data!" << std::endl;
-		return nullptr;
-	}
-
-	// copy memory into texture_data
-	int size = (width)* (height)* (requested_components <= 0 ? components : requested_components);
-	std::vector<char> texture_data(size);
-	memcpy(&texture_data[0], image_data, size);
-	stbi_image_free(image_data);
-
-	// return new texture
-	return new Texture(renderer, width, height, VK_FORMAT_R8G8B8A8_UNORM, texture_data);
+	uint32_t levels = 1;
+	while ((width | height) >> levels)
+		levels++;
+	return levels;
 }
 
 void Texture::Clear(VkClearColorValue color)
@@ -74,33 +56,74 @@ void Texture::Clear(VkClearColorValue color)
 
 
 
+VkImage Texture::GetImage()
+{
+	return _image;
+}
+
+VkImageView Texture::GetImageView()
+{
+	return _image_view;
+}
+
 VkDescriptorImageInfo Texture::GetDescriptor()
 {
 	return _descriptor;
 }
 
+uint32_t Texture::GetWidth()
+{
+	return _width;
+}
 
+uint32_t Texture::GetHeight()
+{
+	return _height;
+}
+
+VkFormat Texture::GetFormat()
+{
+	return _format;
+}
 
-void Texture::_CreateImage(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format)
+uint32_t Texture::GetMipLevels()
+{
+	return _mip_levels;
+}
+
+
+
+void Texture::_CreateImage(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, bool concurrent)
 {
 	VkImageCreateInfo image_create_info = {};
 
+	// written on the compute queue, read on the graphics queue, without ownership transfers.
+	// uploads add the transfer queue, mips are blitted on the graphics queue.
+	uint32_t queue_families[3] = { renderer->GetGraphicsFamilyIndex() };
+	uint32_t queue_family_count = 1;
+	if (renderer->GetComputeFamilyIndex() != queue_families[0])
+		queue_families[queue_family_count++] = renderer->GetComputeFamilyIndex();
+	if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && renderer->GetTransferFamilyIndex() != queue_families[0] && renderer->GetTransferFamilyIndex() != renderer->GetComputeFamilyIndex())
+		queue_families[queue_family_count++] = renderer->GetTransferFamilyIndex();
+	concurrent = concurrent && queue_family_count > 1;
+
 	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	image_create_info.arrayLayers = 1;
 	image_create_info.extent.width = width;
 	image_create_info.extent.height = height;
-	image_create_info.flags = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_create_info.extent.depth = 1;
+	image_create_info.flags = 0;
 	image_create_info.format = format;
 	image_create_info.imageType = VK_IMAGE_TYPE_2D;
 	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	image_create_info.mipLevels = 1;
+	image_create_info.mipLevels = _mip_levels;
 	image_create_info.pNext = nullptr;
-	image_create_info.pQueueFamilyIndices = nullptr;
-	image_create_info.queueFamilyIndexCount = 0;
+	image_create_info.pQueueFamilyIndices = concurrent ? queue_families : nullptr;
+	image_create_info.queueFamilyIndexCount = concurrent ? queue_family_count : 0;
 	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	image_create_info.tiling = VK_IMAGE_TILING_LINEAR;
-	image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	image_create_info.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;			// linear storage images are barely supported, float formats least of all.
+	image_create_info.usage = usage;
 
 	ErrorCheck( vkCreateImage(renderer->GetDevice(), &image_create_info, nullptr, &_image) );
 }
@@ -119,7 +142,7 @@ void Texture::_CreateImageView(Renderer * renderer, VkFormat format, VkImageAspe
 	create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;    // map channel to the shader channel
 	create_info.subresourceRange.aspectMask = aspectMask;		// can be depth
 	create_info.subresourceRange.baseMipLevel = 0;	// first accessed
-	create_info.subresourceRange.levelCount = 1;	// amount of mimap levels. 0 - no image data.
+	create_info.subresourceRange.levelCount = _mip_levels;	// amount of mimap levels. 0 - no image data.
 	create_info.subresourceRange.baseArrayLayer = 0;	// 
 	create_info.subresourceRange.layerCount = 1;	// 0 - no image data. if view type == array, then we need the amount of those images as layer count.
 	
@@ -132,27 +155,12 @@ void Texture::_CreateImageMemory( Renderer * renderer )
 	VkMemoryRequirements image_memory_requirements;
 	vkGetImageMemoryRequirements( renderer->GetDevice(), _image, &image_memory_requirements );
 
-	VkPhysicalDeviceMemoryProperties memory_properties;
-	vkGetPhysicalDeviceMemoryProperties( renderer->GetGPU(), &memory_properties );
-
-	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) 
-	{
-		if ((image_memory_requirements.memoryTypeBits & (1 << i)) &&
-			(memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
-		{
-			VkMemoryAllocateInfo memory_allocate_info = {
-				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,     // VkStructureType                        sType
-				nullptr,                                    // const void                            *pNext
-				image_memory_requirements.size,             // VkDeviceSize                           allocationSize
-				i                                           // uint32_t                               memoryTypeIndex
-			};
-
-			vkAllocateMemory( renderer->GetDevice(), &memory_allocate_info, nullptr, &_memory);
-		}
-	}
+	// optimal tiling, never in a block with buffers.
+	uint32_t memory_type = renderer->GetGPUMemoryType( image_memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+	_allocation = _allocator->Allocate( image_memory_requirements, memory_type, MemoryAllocator::OPTIMAL, MemoryAllocator::TEXTURES );
 
 	// bind memory
-	ErrorCheck( vkBindImageMemory( renderer->GetDevice(), _image, _memory, 0 ) );
+	ErrorCheck( vkBindImageMemory( renderer->GetDevice(), _image, _allocation.memory, _allocation.offset ) );
 }
 
 void Texture::_CreateSampler( Renderer * renderer )
@@ -163,7 +171,7 @@ void Texture::_CreateSampler( Renderer * renderer )
 		0,                                                    // VkSamplerCreateFlags       flags
 		VK_FILTER_LINEAR,                                     // VkFilter                   magFilter
 		VK_FILTER_LINEAR,                                     // VkFilter                   minFilter
-		VK_SAMPLER_MIPMAP_MODE_NEAREST,                       // VkSamplerMipmapMode        mipmapMode
+		VK_SAMPLER_MIPMAP_MODE_LINEAR,                        // VkSamplerMipmapMode        mipmapMode
 		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,                // VkSamplerAddressMode       addressModeU
 		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,                // VkSamplerAddressMode       addressModeV
 		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,                // VkSamplerAddressMode       addressModeW
@@ -173,7 +181,7 @@ void Texture::_CreateSampler( Renderer * renderer )
 		VK_FALSE,                                             // VkBool32                   compareEnable
 		VK_COMPARE_OP_ALWAYS,                                 // VkCompareOp                compareOp
 		0.0f,                                                 // float                      minLod
-		0.0f,                                                 // float                      maxLod
+		(float)_mip_levels,                                   // float                      maxLod
 		VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,              // VkBorderColor              borderColor
 		VK_FALSE                                              // VkBool32                   unnormalizedCoordinates
 	};
@@ -185,165 +193,10 @@ void Texture::_CreateImageDescriptor( )
 {
 	VkDescriptorImageInfo image_info_descriptor = {};
 
-	image_info_descriptor.imageLayout	= VK_IMAGE_LAYOUT_GENERAL;
+	// storage images stay general, sampled ones are left shader read only by their upload.
+	image_info_descriptor.imageLayout	= (_usage & VK_IMAGE_USAGE_STORAGE_BIT) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	image_info_descriptor.imageView		= _image_view;
 	image_info_descriptor.sampler		= _sampler;
 
 	_descriptor							= image_info_descriptor;
 }
-
-void Texture::_CopyTextureData( Renderer * renderer, std::vector<char> texture_data, uint32_t width, uint32_t height )
-{
-	const size_t data_size = texture_data.size();
-
-	// Prepare data in staging buffer
-	void *staging_buffer_memory_pointer;
-	ErrorCheck( vkMapMemory(renderer->GetDevice(), _memory, 0, data_size, 0, &staging_buffer_memory_pointer) );
-	memcpy(staging_buffer_memory_pointer, &texture_data[0], data_size);
-
-	VkMappedMemoryRange flush_range = {
-		VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,              // VkStructureType                        sType
-		nullptr,                                            // const void                            *pNext
-		_memory,                        // VkDeviceMemory                         memory
-		0,                                                  // VkDeviceSize                           offset
-		data_size                                           // VkDeviceSize                           size
-	};
-	vkFlushMappedMemoryRanges(renderer->GetDevice(), 1, &flush_range);
-
-	vkUnmapMemory(renderer->GetDevice(), _memory);
-
-	// Prepare command buffer to copy data from staging buffer to a vertex buffer
-	VkCommandBufferBeginInfo command_buffer_begin_info = {
-		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,        // VkStructureType                        sType
-		nullptr,                                            // const void                            *pNext
-		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,        // VkCommandBufferUsageFlags              flags
-		nullptr                                             // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-	};
-
-	/*VkCommandBuffer command_buffer = Vulkan.RenderingResources[0].CommandBuffer;
-
-	vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
-
-	VkImageSubresourceRange image_subresource_range = {
-		VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
-		0,                                                  // uint32_t                               baseMipLevel
-		1,                                                  // uint32_t                               levelCount
-		0,                                                  // uint32_t                               baseArrayLayer
-		1                                                   // uint32_t                               layerCount
-	};
-
-	VkImageMemoryBarrier image_memory_barrier_from_undefined_to_transfer_dst = {
-		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
-		nullptr,                                            // const void                            *pNext
-		0,                                                  // VkAccessFlags                          srcAccessMask
-		VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          dstAccessMask
-		VK_IMAGE_LAYOUT_UNDEFINED,                          // VkImageLayout                          oldLayout
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          newLayout
-		VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-		VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-		_image,											    // VkImage                                image
-		image_subresource_range                             // VkImageSubresourceRange                subresourceRange
-	};
-	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier_from_undefined_to_transfer_dst);
-
-	/*VkBufferImageCopy buffer_image_copy_info = {
-		0,                                                  // VkDeviceSize                           bufferOffset
-		0,                                                  // uint32_t                               bufferRowLength
-		0,                                                  // uint32_t                               bufferImageHeight
-		{                                                   // VkImageSubresourceLayers               imageSubresource
-			VK_IMAGE_ASPECT_COLOR_BIT,                          // VkImageAspectFlags                     aspectMask
-			0,                                                  // uint32_t                               mipLevel
-		0,                                                  // uint32_t                               baseArrayLayer
-		1                                                   // uint32_t                               layerCount
-		},
-		{                                                   // VkOffset3D                             imageOffset
-			0,                                                  // int32_t                                x
-			0,                                                  // int32_t                                y
-		0                                                   // int32_t                                z
-		},
-		{                                                   // VkExtent3D                             imageExtent
-			width,                                              // uint32_t                               width
-			height,                                             // uint32_t                               height
-		1                                                   // uint32_t                               depth
-		}
-	};
-	vkCmdCopyBufferToImage(command_buffer, Vulkan.StagingBuffer.Handle, Vulkan.Image.Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy_info);
-
-	VkImageMemoryBarrier image_memory_barrier_from_transfer_to_shader_read = {
-		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,             // VkStructureType                        sType
-		nullptr,                                            // const void                            *pNext
-		VK_ACCESS_TRANSFER_WRITE_BIT,                       // VkAccessFlags                          srcAccessMask
-		VK_ACCESS_SHADER_READ_BIT,                          // VkAccessFlags                          dstAccessMask
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,               // VkImageLayout                          oldLayout
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,           // VkImageLayout                          newLayout
-		VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               srcQueueFamilyIndex
-		VK_QUEUE_FAMILY_IGNORED,                            // uint32_t                               dstQueueFamilyIndex
-		Vulkan.Image.Handle,                                // VkImage                                image
-		image_subresource_range                             // VkImageSubresourceRange                subresourceRange
-	};
-	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier_from_transfer_to_shader_read);
-
-	vkEndCommandBuffer(command_buffer);
-
-	// Submit command buffer and copy data from staging buffer to a vertex buffer
-	VkSubmitInfo submit_info = {
-		VK_STRUCTURE_TYPE_SUBMIT_INFO,                      // VkStructureType                        sType
-		nullptr,                                            // const void                            *pNext
-		0,                                                  // uint32_t                               waitSemaphoreCount
-		nullptr,                                            // const VkSemaphore                     *pWaitSemaphores
-		nullptr,                                            // const VkPipelineStageFlags            *pWaitDstStageMask;
-		1,                                                  // uint32_t                               commandBufferCount
-		&command_buffer,                                    // const VkCommandBuffer                 *pCommandBuffers
-		0,                                                  // uint32_t                               signalSemaphoreCount
-		nullptr                                             // const VkSemaphore                     *pSignalSemaphores
-	};
-
-	if (vkQueueSubmit(GetGraphicsQueue().Handle, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-		return false;
-	}
-
-	vkDeviceWaitIdle(GetDevice());
-	*/
-}
-
-/*std::vector<char> Texture::_GetImageContents(std::string file_name)
-{
-	// get binary file contents
-	std::ifstream file(file_name, std::ios::binary);
-	if (file.fail()) {
-		std::cout << "Could not open \"" << file_name << "\" file!" << std::endl;
-		return std::vector<char>();
-	}
-
-	std::streampos begin, end;
-	begin = file.tellg();
-	file.seekg(0, std::ios::end);
-	end = file.tellg();
-
-	std::vector<char> file_data(static_cast<size_t>(end - begin));
-	file.seekg(0, std::ios::beg);
-	file.read(&file_data[0], end - begin);
-	file.close();
-
-	// get image data.
-	int width = 0, height = 0, components = 0, requested_components = 0;
-	unsigned char *image_data = stbi_load_from_memory(reinterpret_cast<unsigned char*>(&file_data[0]), static_cast<int>(file_data.size()), &width, &height, &components, requested_components);
-
-	if ((image_data == nullptr) ||
-		(width <= 0) ||
-		(height <= 0) ||
-		(components <= 0)) {
-			std::cout << "Could not read image data!" << std::endl;
-			return std::vector<char>();
-	}
-
-	int size = (width)* (height)* (requested_components <= 0 ? components : requested_components);
-
-	std::vector<char> texture_data(size);
-	memcpy(&texture_data[0], image_data, size);
-
-	stbi_image_free(image_data);
-
-	return texture_data;
-}
-*/
\ No newline at end of file
@@ -3,36 +3,46 @@
 #include "Platform.h"
 #include "Renderer.h"
 #include "Shared.h"
+#include "base\MemoryAllocator.h"
 
 class Renderer;
 class Texture
 {
 	private:
+		VkDevice						_device;
+		MemoryAllocator			*		_allocator;
+		DeletionQueue			*		_deletion_queue;
 		VkImage							_image;
 		VkImageView						_image_view;
-		VkDeviceMemory					_memory;
+		MemoryAllocator::Allocation		_allocation;
 		VkSampler						_sampler;
 		VkDescriptorImageInfo           _descriptor;
+		uint32_t						_width;
+		uint32_t						_height;
+		VkFormat						_format;
+		uint32_t						_mip_levels;
+		VkImageUsageFlags				_usage;
 
-		void							_CreateImage(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format);
+		void							_CreateImage(Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, bool concurrent);
 		void							_CreateImageView(Renderer * renderer, VkFormat format, VkImageAspectFlagBits aspectMask);
 		void							_CreateImageMemory(Renderer * renderer);
 		void							_CreateSampler(Renderer * renderer);
 		void							_CreateImageDescriptor();
-		void							_CopyTextureData(Renderer * renderer, std::vector<char> texture_data, uint32_t width, uint32_t height);
-
-		//static std::vector<char>		_GetImageContents(std::string file_name);
 
 	public:
-		Texture( Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, std::vector<char> texture_data = std::vector<char>(), VkImageAspectFlagBits aspectMask = VK_IMAGE_ASPECT_COLOR_BIT);
+		Texture( Renderer * renderer, uint32_t width, uint32_t height, VkFormat format, uint32_t mip_levels = 1, VkImageAspectFlagBits aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, bool concurrent = false);
 		~Texture();
 
-		static Texture  	*			Load( Renderer * renderer, std::string file_name );
+		static uint32_t					GetMipCount( uint32_t width, uint32_t height );
 
 		void							Clear( VkClearColorValue color );
 
 		VkImage							GetImage();
 		VkImageView						GetImageView();
 		VkDescriptorImageInfo           GetDescriptor();
+		uint32_t						GetWidth();
+		uint32_t						GetHeight();
+		VkFormat						GetFormat();
+		uint32_t						GetMipLevels();
 };
 
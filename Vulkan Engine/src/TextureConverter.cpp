@@ -0,0 +1,250 @@
+#include "TextureConverter.h"
+#include "Ktx2.h"
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+
+#include <stb-master\stb-master\stb_image.h>
+
+static const char * format_names[TextureConverter::FORMAT_COUNT] = { "bc1", "bc5" };
+
+// the 4x4 block at bx, by, edge texels repeated for sizes that are not multiples of 4.
+static void FetchBlock( const unsigned char * rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, unsigned char block[16][4] )
+{
+	for ( uint32_t y = 0; y < 4; y++ )
+	{
+		for ( uint32_t x = 0; x < 4; x++ )
+		{
+			uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+			memcpy( block[y * 4 + x], &rgba[( (size_t)sy * width + sx ) * 4], 4 );
+		}
+	}
+}
+
+static uint16_t To565( const int color[3] )
+{
+	return (uint16_t)( ( ( color[0] * 31 + 127 ) / 255 ) << 11 | ( ( color[1] * 63 + 127 ) / 255 ) << 5 | ( ( color[2] * 31 + 127 ) / 255 ) );
+}
+
+static void From565( uint16_t packed, int color[3] )
+{
+	int r = ( packed >> 11 ) & 31, g = ( packed >> 5 ) & 63, b = packed & 31;
+	color[0] = ( r << 3 ) | ( r >> 2 );
+	color[1] = ( g << 2 ) | ( g >> 4 );
+	color[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+// endpoints are the corners of the color bounding box, every texel takes the closest of the four palette colors.
+static void EncodeBC1Block( unsigned char block[16][4], unsigned char * out )
+{
+	int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+	for ( uint32_t i = 0; i < 16; i++ )
+	{
+		for ( uint32_t c = 0; c < 3; c++ )
+		{
+			low[c]	= block[i][c] < low[c] ? block[i][c] : low[c];
+			high[c]	= block[i][c] > high[c] ? block[i][c] : high[c];
+		}
+	}
+
+	uint16_t color0 = To565( high );
+	uint16_t color1 = To565( low );
+
+	// color0 > color1 selects the four color mode, the same endpoints leave every index at 0.
+	if ( color0 < color1 ) {
+		uint16_t swap = color0; color0 = color1; color1 = swap;
+	}
+
+	int palette[4][3];
+	From565( color0, palette[0] );
+	From565( color1, palette[1] );
+	for ( uint32_t c = 0; c < 3; c++ )
+	{
+		palette[2][c] = ( 2 * palette[0][c] + palette[1][c] ) / 3;
+		palette[3][c] = ( palette[0][c] + 2 * palette[1][c] ) / 3;
+	}
+
+	uint32_t indices = 0;
+	if ( color0 != color1 )
+	{
+		for ( uint32_t i = 0; i < 16; i++ )
+		{
+			uint32_t best = 0;
+			int best_distance = INT_MAX;
+			for ( uint32_t p = 0; p < 4; p++ )
+			{
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if ( distance < best_distance ) {
+					best			= p;
+					best_distance	= distance;
+				}
+			}
+			indices |= best << ( i * 2 );
+		}
+	}
+
+	memcpy( out, &color0, 2 );
+	memcpy( out + 2, &color1, 2 );
+	memcpy( out + 4, &indices, 4 );
+}
+
+// one channel, eight interpolated values between the block's min and max.
+static void EncodeBC4Block( unsigned char block[16][4], uint32_t channel, unsigned char * out )
+{
+	int low = 255, high = 0;
+	for ( uint32_t i = 0; i < 16; i++ )
+	{
+		low		= block[i][channel] < low ? block[i][channel] : low;
+		high	= block[i][channel] > high ? block[i][channel] : high;
+	}
+
+	// alpha0 > alpha1 selects the eight value mode.
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for ( uint32_t k = 1; k < 7; k++ )
+		palette[1 + k] = ( ( 7 - k ) * high + k * low ) / 7;
+
+	uint64_t indices = 0;
+	if ( high != low )
+	{
+		for ( uint32_t i = 0; i < 16; i++ )
+		{
+			uint64_t best = 0;
+			int best_distance = INT_MAX;
+			for ( uint32_t p = 0; p < 8; p++ )
+			{
+				int distance = block[i][channel] > palette[p] ? block[i][channel] - palette[p] : palette[p] - block[i][channel];
+				if ( distance < best_distance ) {
+					best			= p;
+					best_distance	= distance;
+				}
+			}
+			indices |= best << ( i * 3 );
+		}
+	}
+
+	out[0] = (unsigned char)high;
+	out[1] = (unsigned char)low;
+	for ( uint32_t b = 0; b < 6; b++ )
+		out[2 + b] = (unsigned char)( indices >> ( b * 8 ) );
+}
+
+// 2x2 box filter, odd sizes fold their last row or column into the one before.
+static std::vector<unsigned char> Downsample( const std::vector<unsigned char> & rgba, uint32_t width, uint32_t height )
+{
+	uint32_t next_width		= width > 1 ? width / 2 : 1;
+	uint32_t next_height	= height > 1 ? height / 2 : 1;
+
+	std::vector<unsigned char> next( (size_t)next_width * next_height * 4 );
+	for ( uint32_t y = 0; y < next_height; y++ )
+	{
+		for ( uint32_t x = 0; x < next_width; x++ )
+		{
+			uint32_t x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : x * 2;
+			uint32_t y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : y * 2;
+			for ( uint32_t c = 0; c < 4; c++ )
+			{
+				uint32_t sum =	rgba[( (size_t)y0 * width + x0 ) * 4 + c] + rgba[( (size_t)y0 * width + x1 ) * 4 + c] +
+								rgba[( (size_t)y1 * width + x0 ) * 4 + c] + rgba[( (size_t)y1 * width + x1 ) * 4 + c];
+				next[( (size_t)y * next_width + x ) * 4 + c] = (unsigned char)( ( sum + 2 ) / 4 );
+			}
+		}
+	}
+	return next;
+}
+
+
+
+bool TextureConverter::ParseFormat( std::string name, Format & format )
+{
+	for ( uint32_t i = 0; i < FORMAT_COUNT; i++ )
+	{
+		if ( name == format_names[i] )
+		{
+			format = (Format)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<unsigned char> TextureConverter::EncodeBC1( const unsigned char * rgba, uint32_t width, uint32_t height )
+{
+	uint32_t blocks_x = ( width + 3 ) / 4;
+	uint32_t blocks_y = ( height + 3 ) / 4;
+
+	std::vector<unsigned char> blocks( (size_t)blocks_x * blocks_y * 8 );
+	unsigned char block[16][4];
+	for ( uint32_t by = 0; by < blocks_y; by++ )
+	{
+		for ( uint32_t bx = 0; bx < blocks_x; bx++ )
+		{
+			FetchBlock( rgba, width, height, bx, by, block );
+			EncodeBC1Block( block, &blocks[( (size_t)by * blocks_x + bx ) * 8] );
+		}
+	}
+	return blocks;
+}
+
+// red and green as two bc4 blocks, red first.
+std::vector<unsigned char> TextureConverter::EncodeBC5( const unsigned char * rgba, uint32_t width, uint32_t height )
+{
+	uint32_t blocks_x = ( width + 3 ) / 4;
+	uint32_t blocks_y = ( height + 3 ) / 4;
+
+	std::vector<unsigned char> blocks( (size_t)blocks_x * blocks_y * 16 );
+	unsigned char block[16][4];
+	for ( uint32_t by = 0; by < blocks_y; by++ )
+	{
+		for ( uint32_t bx = 0; bx < blocks_x; bx++ )
+		{
+			unsigned char * out = &blocks[( (size_t)by * blocks_x + bx ) * 16];
+			FetchBlock( rgba, width, height, bx, by, block );
+			EncodeBC4Block( block, 0, out );
+			EncodeBC4Block( block, 1, out + 8 );
+		}
+	}
+	return blocks;
+}
+
+bool TextureConverter::Convert( std::string input_file, std::string output_file, Format format )
+{
+	int width = 0, height = 0, components = 0;
+	unsigned char * pixels = stbi_load( input_file.c_str(), &width, &height, &components, 4 );
+	if ( pixels == nullptr || width <= 0 || height <= 0 ) {
+		std::cout << "Could not read texture \"" << input_file << "\"." << std::endl;
+		stbi_image_free( pixels );
+		return false;
+	}
+
+	std::vector<unsigned char> level( pixels, pixels + (size_t)width * height * 4 );
+	stbi_image_free( pixels );
+
+	// the full chain down to 1x1, every level encoded from the filtered level above.
+	std::vector<std::vector<unsigned char>> levels;
+	uint32_t level_width	= (uint32_t)width;
+	uint32_t level_height	= (uint32_t)height;
+	while ( true )
+	{
+		if ( format == BC1 )	levels.push_back( EncodeBC1( level.data(), level_width, level_height ) );
+		else					levels.push_back( EncodeBC5( level.data(), level_width, level_height ) );
+
+		if ( level_width == 1 && level_height == 1 )
+			break;
+
+		level			= Downsample( level, level_width, level_height );
+		level_width		= level_width > 1 ? level_width / 2 : 1;
+		level_height	= level_height > 1 ? level_height / 2 : 1;
+	}
+
+	VkFormat vk_format = format == BC1 ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC5_UNORM_BLOCK;
+	if ( !Ktx2::Write( output_file, vk_format, (uint32_t)width, (uint32_t)height, levels ) )
+		return false;
+
+	std::cout << "Converted \"" << input_file << "\" to " << format_names[format] << ", " << levels.size() << " levels in \"" << output_file << "\"." << std::endl;
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Platform.h"
+
+// Offline transcoding of source images ( .png, .jpg, .tga, ... ) into block compressed KTX 2.0 textures.
+// Mips are box filtered on the cpu and every level is encoded, the streamer uploads them as they are.
+class TextureConverter
+{
+	public:
+		enum Format
+		{
+			BC1,							// rgb colors, 4 bits per texel
+			BC5,							// two channels, normal maps, 8 bits per texel
+			FORMAT_COUNT
+		};
+
+	public:
+		static bool							ParseFormat( std::string name, Format & format );
+		static bool							Convert( std::string input_file, std::string output_file, Format format );
+
+		// rgba texels in, blocks out, width and height need not be multiples of 4.
+		static std::vector<unsigned char>	EncodeBC1( const unsigned char * rgba, uint32_t width, uint32_t height );
+		static std::vector<unsigned char>	EncodeBC5( const unsigned char * rgba, uint32_t width, uint32_t height );
+};
@@ -0,0 +1,444 @@
+#include "TextureStreamer.h"
+#include "ImageFile.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb-master\stb-master\stb_image.h>
+
+// copy offsets into the staging ring, a multiple of every texel size.
+static const VkDeviceSize staging_alignment = 16;
+
+static void LevelBarrier( VkCommandBuffer command_buffer, VkImage image, uint32_t level, uint32_t level_count,
+						  VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access,
+						  VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage )
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask					= src_access;
+	barrier.dstAccessMask					= dst_access;
+	barrier.oldLayout						= old_layout;
+	barrier.newLayout						= new_layout;
+	barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.image							= image;
+	barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel	= level;
+	barrier.subresourceRange.levelCount		= level_count;
+	barrier.subresourceRange.baseArrayLayer	= 0;
+	barrier.subresourceRange.layerCount		= 1;
+	vkCmdPipelineBarrier( command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+}
+
+
+
+TextureStreamer::TextureStreamer( Renderer * renderer, uint32_t staging_size, uint32_t worker_count )
+{
+	_renderer		= renderer;
+	_staging_size	= staging_size;
+	_staging		= new DataBuffer( renderer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, nullptr, staging_size );
+
+	for ( uint32_t i = 0; i < worker_count; i++ )
+		_workers.push_back( new Worker() );
+
+	VkCommandPoolCreateInfo create_info = Structs::CommandPoolCreateInfo( _renderer->GetTransferFamilyIndex() );
+	create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	ErrorCheck( vkCreateCommandPool( _renderer->GetDevice(), &create_info, nullptr, &_copy_command_pool ),
+		"Unable to create a texture upload command pool.", "Texture upload command pool created." );
+
+	// blits need a graphics queue.
+	create_info.queueFamilyIndex = _renderer->GetGraphicsFamilyIndex();
+	ErrorCheck( vkCreateCommandPool( _renderer->GetDevice(), &create_info, nullptr, &_mip_command_pool ),
+		"Unable to create a mip generation command pool.", "Mip generation command pool created." );
+
+	// without linear blits textures keep their first level only.
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties( _renderer->GetGPU(), VK_FORMAT_R8G8B8A8_UNORM, &format_properties );
+	VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	_mips = ( format_properties.optimalTilingFeatures & blit_features ) == blit_features;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Flush();
+
+	for ( Worker * worker : _workers )
+		delete worker;
+
+	vkDestroyCommandPool( _renderer->GetDevice(), _copy_command_pool, nullptr );
+	vkDestroyCommandPool( _renderer->GetDevice(), _mip_command_pool, nullptr );
+	delete _staging;
+}
+
+
+
+// the callback runs on the thread calling Poll(), with nullptr when the file can't be read.
+void TextureStreamer::Load( std::string file_name, Callback callback )
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_decoding++;
+	}
+
+	Worker * worker = _workers[_next_worker++ % _workers.size()];
+	worker->Push( [this, file_name, callback] {
+		Decoded decoded;
+		decoded.file_name	= file_name;
+		decoded.callback	= callback;
+
+		// already in the format it is sampled in, only read.
+		if ( ImageFile::GetExtension( file_name ) == "ktx2" )
+		{
+			decoded.compressed = new Ktx2::Image();
+			if ( Ktx2::Read( file_name, *decoded.compressed ) && _IsSampleable( decoded.compressed->format ) &&
+				 decoded.compressed->levels.size() <= Texture::GetMipCount( decoded.compressed->width, decoded.compressed->height ) )
+			{
+				decoded.width	= decoded.compressed->width;
+				decoded.height	= decoded.compressed->height;
+			}
+			else
+			{
+				std::cout << "Could not read texture \"" << file_name << "\"." << std::endl;
+				delete decoded.compressed;
+				decoded.compressed = nullptr;
+			}
+		}
+
+		// straight from the file, always rgba.
+		else
+		{
+			int width = 0, height = 0, components = 0;
+			decoded.pixels = stbi_load( file_name.c_str(), &width, &height, &components, 4 );
+			if ( decoded.pixels != nullptr && width > 0 && height > 0 )
+			{
+				decoded.width	= (uint32_t)width;
+				decoded.height	= (uint32_t)height;
+			}
+			else
+			{
+				std::cout << "Could not read texture \"" << file_name << "\"." << std::endl;
+				stbi_image_free( decoded.pixels );
+				decoded.pixels = nullptr;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock( _mutex );
+		_decoded.push_back( decoded );
+		_decoding--;
+	} );
+}
+
+// hands over finished uploads and starts new ones while the staging ring has room.
+void TextureStreamer::Poll()
+{
+	// oldest first, non blocking, an upload still running is picked up on a later frame.
+	while ( !_uploads.empty() && vkGetFenceStatus( _renderer->GetDevice(), _uploads.front().fence ) == VK_SUCCESS )
+	{
+		Upload upload = _uploads.front();
+		_uploads.pop_front();
+
+		_Retire( &upload );
+		upload.callback( upload.texture );
+	}
+
+	// in load order, a decoded image waits for the uploads in front of it to free staging space.
+	while ( true )
+	{
+		Decoded decoded;
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			if ( _decoded.empty() )
+				break;
+			decoded = _decoded.front();
+		}
+
+		Upload upload;
+		upload.callback = decoded.callback;
+
+		bool failed = decoded.pixels == nullptr && decoded.compressed == nullptr;
+		if ( !failed && !_Stage( decoded, &upload ) )
+			break;
+
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_decoded.pop_front();
+		}
+
+		if ( failed )
+		{
+			decoded.callback( nullptr );
+			continue;
+		}
+
+		_Submit( &upload, decoded );
+		_uploads.push_back( upload );
+
+		stbi_image_free( decoded.pixels );
+		delete decoded.compressed;
+	}
+}
+
+// waits for every load, for shutdown only.
+void TextureStreamer::Flush()
+{
+	for ( Worker * worker : _workers )
+		worker->Wait();
+
+	while ( !IsIdle() )
+	{
+		if ( !_uploads.empty() )
+			vkWaitForFences( _renderer->GetDevice(), 1, &_uploads.front().fence, VK_TRUE, UINT64_MAX );
+		Poll();
+	}
+}
+
+bool TextureStreamer::IsIdle()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _decoding == 0 && _decoded.empty() && _uploads.empty();
+}
+
+
+
+// copies the pixels into the staging ring behind the uploads in flight, false when there is no room yet.
+bool TextureStreamer::_Stage( const Decoded & decoded, Upload * upload )
+{
+	const unsigned char * data = decoded.pixels;
+	VkDeviceSize size = (VkDeviceSize)decoded.width * decoded.height * 4;
+
+	// every level in one go, from the first one in the file to the end of the last.
+	if ( decoded.compressed != nullptr )
+	{
+		VkDeviceSize begin = UINT64_MAX, end = 0;
+		for ( const Ktx2::Level & level : decoded.compressed->levels )
+		{
+			begin	= level.offset < begin ? level.offset : begin;
+			end		= level.offset + level.size > end ? level.offset + level.size : end;
+		}
+		data	= &decoded.compressed->data[(size_t)begin];
+		size	= end - begin;
+		upload->level_base = begin;
+	}
+
+	VkDeviceSize aligned = ( size + staging_alignment - 1 ) / staging_alignment * staging_alignment;
+
+	upload->size = size;
+
+	// bigger than the whole ring, staged on its own.
+	if ( aligned > _staging_size )
+	{
+		upload->dedicated = new DataBuffer( _renderer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, (void*)data, size );
+		return true;
+	}
+
+	// the ring is in use from the oldest upload staged in it up to the head.
+	const Upload * oldest = nullptr;
+	for ( const Upload & in_flight : _uploads )
+	{
+		if ( in_flight.dedicated == nullptr ) {
+			oldest = &in_flight;
+			break;
+		}
+	}
+
+	VkDeviceSize offset = 0;
+	if ( oldest == nullptr )
+	{
+		offset = 0;
+	}
+	else if ( _staging_head > oldest->offset )
+	{
+		if ( _staging_head + aligned <= _staging_size )		offset = _staging_head;
+		else if ( aligned < oldest->offset )				offset = 0;
+		else												return false;
+	}
+	else
+	{
+		if ( _staging_head + aligned < oldest->offset )		offset = _staging_head;
+		else												return false;
+	}
+
+	_staging->Update( data, offset, size );
+	_staging_head	= offset + aligned;
+	upload->offset	= offset;
+	return true;
+}
+
+// copy on the transfer queue, then mips on the graphics queue once the copy signalled.
+void TextureStreamer::_Submit( Upload * upload, const Decoded & decoded )
+{
+	VkDevice device		= _renderer->GetDevice();
+	uint32_t width		= decoded.width;
+	uint32_t height		= decoded.height;
+	uint32_t mip_levels	= _mips ? Texture::GetMipCount( width, height ) : 1;
+	VkFormat format		= VK_FORMAT_R8G8B8A8_UNORM;
+	bool     blit		= mip_levels > 1;
+
+	// compressed files bring their own levels.
+	if ( decoded.compressed != nullptr )
+	{
+		mip_levels	= (uint32_t)decoded.compressed->levels.size();
+		format		= decoded.compressed->format;
+		blit		= false;
+	}
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | ( blit ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0 );
+	upload->texture = new Texture( _renderer, width, height, format, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT, usage, true );
+
+	VkFenceCreateInfo fence_create_info = Structs::FenceCreateInfo();
+	fence_create_info.flags = 0;
+	ErrorCheck( vkCreateFence( device, &fence_create_info, nullptr, &upload->fence ), "Unable to create texture upload fence." );
+
+	VkBuffer buffer = upload->dedicated != nullptr ? upload->dedicated->GetBuffer() : _staging->GetBuffer();
+	_RecordCopy( upload, buffer, decoded );
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount	= 1;
+	submit_info.pCommandBuffers		= &upload->copy_command_buffer;
+
+	if ( !blit )
+	{
+		ErrorCheck( vkQueueSubmit( _renderer->GetTransferQueue(), 1, &submit_info, upload->fence ), "Unable to submit texture upload." );
+		return;
+	}
+
+	ErrorCheck( vkCreateSemaphore( device, &Structs::SemaphoreCreateInfo(), nullptr, &upload->copied ), "Unable to create texture upload semaphore." );
+	submit_info.signalSemaphoreCount	= 1;
+	submit_info.pSignalSemaphores		= &upload->copied;
+	ErrorCheck( vkQueueSubmit( _renderer->GetTransferQueue(), 1, &submit_info, VK_NULL_HANDLE ), "Unable to submit texture upload." );
+
+	_RecordMips( upload, width, height );
+
+	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo mip_submit_info = {};
+	mip_submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	mip_submit_info.waitSemaphoreCount	= 1;
+	mip_submit_info.pWaitSemaphores		= &upload->copied;
+	mip_submit_info.pWaitDstStageMask	= &wait_stage;
+	mip_submit_info.commandBufferCount	= 1;
+	mip_submit_info.pCommandBuffers		= &upload->mip_command_buffer;
+	ErrorCheck( vkQueueSubmit( _renderer->GetQueue(), 1, &mip_submit_info, upload->fence ), "Unable to submit mip generation." );
+}
+
+void TextureStreamer::_RecordCopy( Upload * upload, VkBuffer buffer, const Decoded & decoded )
+{
+	VkImage  image		= upload->texture->GetImage();
+	uint32_t mip_levels	= upload->texture->GetMipLevels();
+
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _copy_command_pool, 1 );
+	ErrorCheck( vkAllocateCommandBuffers( _renderer->GetDevice(), &allocate_info, &upload->copy_command_buffer ), "Unable to allocate texture upload command buffer." );
+
+	VkCommandBufferBeginInfo begin_info = Structs::CommandBufferBeginInfo();
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer( upload->copy_command_buffer, &begin_info );
+
+	// every level is a blit destination later on.
+	LevelBarrier( upload->copy_command_buffer, image, 0, mip_levels,
+				  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT );
+
+	// the first level only, or every compressed level where it landed in the staged range.
+	uint32_t copy_levels = decoded.compressed != nullptr ? mip_levels : 1;
+	std::vector<VkBufferImageCopy> regions( copy_levels );
+	for ( uint32_t level = 0; level < copy_levels; level++ )
+	{
+		VkBufferImageCopy & region = regions[level];
+		region = {};
+		region.bufferOffset						= upload->dedicated != nullptr ? 0 : upload->offset;
+		region.imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel		= level;
+		region.imageSubresource.baseArrayLayer	= 0;
+		region.imageSubresource.layerCount		= 1;
+		region.imageExtent.width				= decoded.width >> level > 0 ? decoded.width >> level : 1;
+		region.imageExtent.height				= decoded.height >> level > 0 ? decoded.height >> level : 1;
+		region.imageExtent.depth				= 1;
+		if ( decoded.compressed != nullptr )
+			region.bufferOffset += decoded.compressed->levels[level].offset - upload->level_base;
+	}
+	vkCmdCopyBufferToImage( upload->copy_command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy_levels, regions.data() );
+
+	// nothing to blit, ready for sampling right away.
+	if ( decoded.compressed != nullptr || mip_levels == 1 )
+	{
+		LevelBarrier( upload->copy_command_buffer, image, 0, mip_levels,
+					  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+	}
+
+	ErrorCheck( vkEndCommandBuffer( upload->copy_command_buffer ), "Unable to record texture upload command buffer." );
+}
+
+// every level is a linear blit of the one above, then left shader read only.
+void TextureStreamer::_RecordMips( Upload * upload, uint32_t width, uint32_t height )
+{
+	VkImage  image		= upload->texture->GetImage();
+	uint32_t mip_levels	= upload->texture->GetMipLevels();
+
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo( _mip_command_pool, 1 );
+	ErrorCheck( vkAllocateCommandBuffers( _renderer->GetDevice(), &allocate_info, &upload->mip_command_buffer ), "Unable to allocate mip generation command buffer." );
+
+	VkCommandBufferBeginInfo begin_info = Structs::CommandBufferBeginInfo();
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer( upload->mip_command_buffer, &begin_info );
+
+	int32_t level_width		= (int32_t)width;
+	int32_t level_height	= (int32_t)height;
+
+	for ( uint32_t level = 1; level < mip_levels; level++ )
+	{
+		int32_t next_width	= level_width > 1 ? level_width / 2 : 1;
+		int32_t next_height	= level_height > 1 ? level_height / 2 : 1;
+
+		LevelBarrier( upload->mip_command_buffer, image, level - 1, 1,
+					  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT );
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel		= level - 1;
+		blit.srcSubresource.layerCount		= 1;
+		blit.srcOffsets[1]					= { level_width, level_height, 1 };
+		blit.dstSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel		= level;
+		blit.dstSubresource.layerCount		= 1;
+		blit.dstOffsets[1]					= { next_width, next_height, 1 };
+		vkCmdBlitImage( upload->mip_command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR );
+
+		LevelBarrier( upload->mip_command_buffer, image, level - 1, 1,
+					  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, 0,
+					  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+
+		level_width		= next_width;
+		level_height	= next_height;
+	}
+
+	LevelBarrier( upload->mip_command_buffer, image, mip_levels - 1, 1,
+				  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+				  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+
+	ErrorCheck( vkEndCommandBuffer( upload->mip_command_buffer ), "Unable to record mip generation command buffer." );
+}
+
+// compressed formats are optional, BC needs textureCompressionBC.
+bool TextureStreamer::_IsSampleable( VkFormat format )
+{
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties( _renderer->GetGPU(), format, &format_properties );
+	if ( format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT )
+		return true;
+
+	std::cout << "Texture format " << format << " can't be sampled on this gpu." << std::endl;
+	return false;
+}
+
+void TextureStreamer::_Retire( Upload * upload )
+{
+	VkDevice device = _renderer->GetDevice();
+
+	vkFreeCommandBuffers( device, _copy_command_pool, 1, &upload->copy_command_buffer );
+	if ( upload->mip_command_buffer != VK_NULL_HANDLE )
+		vkFreeCommandBuffers( device, _mip_command_pool, 1, &upload->mip_command_buffer );
+	if ( upload->copied != VK_NULL_HANDLE )
+		vkDestroySemaphore( device, upload->copied, nullptr );
+	vkDestroyFence( device, upload->fence, nullptr );
+	delete upload->dedicated;
+}
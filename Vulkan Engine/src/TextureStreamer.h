@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <functional>
+
+#include "Platform.h"
+#include "Shared.h"
+#include "Renderer.h"
+#include "Texture.h"
+#include "Ktx2.h"
+#include "base\Worker.h"
+#include "base\DataBuffer.h"
+#include "base\helpers\Structs.h"
+
+// Loads textures without ever stalling the render loop.
+// Files are decoded on worker threads, copied through a staging ring on the transfer queue,
+// and their mips are blitted on the graphics queue. Poll() hands finished textures over, it never waits.
+// KTX 2.0 files skip decoding and blitting, their block compressed levels are copied as they are.
+class TextureStreamer
+{
+	public:
+		typedef std::function<void( Texture * texture )>	Callback;
+
+	private:
+		// decoded on a worker, waiting for staging space.
+		struct Decoded
+		{
+			std::string						file_name;
+			Callback						callback;
+			unsigned char		*			pixels					= nullptr;		// rgba from stb
+			Ktx2::Image			*			compressed				= nullptr;		// block compressed levels from a .ktx2
+			uint32_t						width					= 0;
+			uint32_t						height					= 0;
+		};
+
+		// copied and blitted on the gpu, in submission order.
+		struct Upload
+		{
+			Texture				*			texture					= nullptr;
+			Callback						callback;
+			DataBuffer			*			dedicated				= nullptr;		// staging of images bigger than the ring
+			VkDeviceSize					offset					= 0;
+			VkDeviceSize					size					= 0;
+			VkDeviceSize					level_base				= 0;			// file offset of the staged range of a .ktx2
+			VkCommandBuffer					copy_command_buffer		= VK_NULL_HANDLE;
+			VkCommandBuffer					mip_command_buffer		= VK_NULL_HANDLE;
+			VkSemaphore						copied					= VK_NULL_HANDLE;
+			VkFence							fence					= VK_NULL_HANDLE;
+		};
+
+		Renderer				*			_renderer				= nullptr;
+		std::vector<Worker*>				_workers;
+		uint32_t							_next_worker			= 0;
+		uint32_t							_decoding				= 0;
+
+		std::mutex							_mutex;
+		std::deque<Decoded>					_decoded;
+		std::deque<Upload>					_uploads;
+
+		DataBuffer				*			_staging				= nullptr;
+		VkDeviceSize						_staging_size			= 0;
+		VkDeviceSize						_staging_head			= 0;
+
+		VkCommandPool						_copy_command_pool		= VK_NULL_HANDLE;
+		VkCommandPool						_mip_command_pool		= VK_NULL_HANDLE;
+		bool								_mips					= false;
+
+		bool								_Stage( const Decoded & decoded, Upload * upload );
+		void								_Submit( Upload * upload, const Decoded & decoded );
+		void								_RecordCopy( Upload * upload, VkBuffer buffer, const Decoded & decoded );
+		void								_RecordMips( Upload * upload, uint32_t width, uint32_t height );
+		void								_Retire( Upload * upload );
+		bool								_IsSampleable( VkFormat format );
+
+	public:
+		TextureStreamer( Renderer * renderer, uint32_t staging_size = 32 * 1024 * 1024, uint32_t worker_count = 2 );
+		~TextureStreamer();
+
+		void								Load( std::string file_name, Callback callback );
+		void								Poll();
+		void								Flush();
+		bool								IsIdle();
+};
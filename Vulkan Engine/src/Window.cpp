@@ -28,10 +28,13 @@ Window::Window( Renderer * renderer, uint32_t size_x, uint32_t size_y, std::stri
 	_CreatePresentationSampler( renderer );*/
 }
 
+// the swapchain goes before its surface.
 Window::~Window()
 {
-	_DeInitOSWindow();
+	delete _presentation;
+
 	_DeInitSurface();
+	_DeInitOSWindow();
 }
 
 
@@ -52,6 +55,35 @@ bool Window::Update()
 	return _window_should_run;
 }
 
+// called by the OS window, the swapchain follows in RecreateSwapchain().
+void Window::Resize(uint32_t size_x, uint32_t size_y)
+{
+	_minimized = size_x == 0 || size_y == 0;
+	if (_minimized || (size_x == _surface_size_x && size_y == _surface_size_y))
+		return;
+
+	_surface_size_x = size_x;
+	_surface_size_y = size_y;
+	_resized = true;
+}
+
+// true when a new swapchain was created, everything bound to the old images has to be rebuilt.
+// also when presenting found the old one out of date before the window got its resize.
+bool Window::RecreateSwapchain()
+{
+	bool recreated = _presentation->WasRecreated();
+	if (!_resized || _minimized)
+		return recreated;
+
+	_resized = false;
+	return _presentation->Resize(_surface_size_x, _surface_size_y) || recreated;
+}
+
+bool Window::IsMinimized()
+{
+	return _minimized;
+}
+
 
 HWND Window::GetHandle()
 {
@@ -137,7 +169,9 @@ LRESULT CALLBACK WindowsEventHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
 	case WM_SIZE:
 		// we get here if the window has changed size, we should rebuild most
 		// of our window resources before rendering to this window again.
-		// ( no need for this because our window sizing by hand is disabled )
+		// ( WM_SIZE also arrives from CreateWindowEx, before the user data is set )
+		if (window != nullptr)
+			window->Resize(LOWORD(lParam), HIWORD(lParam));
 		break;
 	default:
 		break;
@@ -179,7 +213,7 @@ void Window::_InitOSWindow()
 	}
 
 	DWORD ex_style = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
-	DWORD style = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX;
+	DWORD style = WS_OVERLAPPEDWINDOW;
 
 	// Create window with the registered class:
 	RECT wr = { 0, 0, LONG(_surface_size_x), LONG(_surface_size_y) };
@@ -19,6 +19,8 @@ private:
 	std::string							_window_name;
 
 	bool								_window_should_run = true;
+	bool								_resized = false;
+	bool								_minimized = false;
 
 	Renderer				*			_renderer;
 	Presentation			*			_presentation;
@@ -36,6 +38,10 @@ public:
 	void								Close();
 	bool								Update();
 
+	void								Resize(uint32_t size_x, uint32_t size_y);
+	bool								RecreateSwapchain();
+	bool								IsMinimized();
+
 	HWND								GetHandle();
 	Presentation		*				GetPresentation();
 
@@ -1,13 +1,13 @@
 #include "DataBuffer.h"
 
-DataBuffer::DataBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, uint32_t buffer_size, VkDeviceSize offset)
+DataBuffer::DataBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, VkDeviceSize buffer_size, VkDeviceSize offset)
 {
-	_buffer_size = buffer_size;
-	_offset      = offset;
+	_device         = renderer->GetDevice();
+	_allocator      = renderer->GetAllocator();
+	_deletion_queue = renderer->GetDeletionQueue();
+	_buffer_size    = buffer_size;
+	_offset         = offset;
 
-	// prerequisities
-	VkMemoryPropertyFlags	memory_property_flags	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	
 	// create buffer
 	VkBufferCreateInfo		buffer_create_info = Structs::BufferCreateInfo(usage_flags, _buffer_size);
 	ErrorCheck( vkCreateBuffer(renderer->GetDevice(), &buffer_create_info, nullptr, &_buffer), "Unable to create buffer");
@@ -15,40 +15,62 @@ DataBuffer::DataBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, voi
 	// get memory requirements
 	vkGetBufferMemoryRequirements(renderer->GetDevice(), *&_buffer, &_memory_requirements);
 
-	// allocate memory
-	VkMemoryAllocateInfo	memory_allocation_info = Structs::MemoryAllocateInfo();
-	memory_allocation_info.allocationSize  = _memory_requirements.size;
-	memory_allocation_info.memoryTypeIndex = renderer->GetGPUMemoryType(_memory_requirements.memoryTypeBits, memory_property_flags);
-	ErrorCheck(vkAllocateMemory(renderer->GetDevice(), &memory_allocation_info, nullptr, &_memory), "Unable to allocate GPU memory.");
+	// allocate memory, writes to memory that isn't coherent are flushed by Update().
+	VkBool32 found = false;
+	uint32_t memory_type = renderer->GetGPUMemoryType(_memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &found);
+	if (!found)
+		memory_type = renderer->GetGPUMemoryType(_memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	// shared block, stays mapped for the lifetime of the allocator, updates are a memcpy.
+	// buffers only ever copied from or to are staging.
+	bool staging = (usage_flags & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) == 0;
+	_allocation = _allocator->Allocate(_memory_requirements, memory_type, MemoryAllocator::LINEAR, staging ? MemoryAllocator::STAGING : MemoryAllocator::BUFFERS);
+
+	// bind memory
+	ErrorCheck( vkBindBufferMemory(renderer->GetDevice(), *&_buffer, _allocation.memory, _allocation.offset), "Unable to bind buffer memory to GPU." );
 
 	// create buffer memory
 	if (data != nullptr)
-	{
-		ErrorCheck(vkMapMemory(renderer->GetDevice(), *&_memory, _offset, buffer_size, 0, &_mapped), "Unable to map GPU memory.");
-		memcpy(_mapped, data, _buffer_size);
-		vkUnmapMemory(renderer->GetDevice(), _memory);
-	}
+		Update(data);
 
 	// create descriptor set
 	_descriptor_info = Structs::DescriptorBufferInfo(_buffer, _buffer_size);
-
-	// bind memory
-	ErrorCheck( vkBindBufferMemory(renderer->GetDevice(), *&_buffer, *&_memory, 0), "Unable to bind buffer memory to GPU." );
 }
 
+// frames in flight may still read the buffer, it goes once they retired.
 DataBuffer::~DataBuffer()
 {
+	VkDevice device = _device;
+	MemoryAllocator * allocator = _allocator;
+	VkBuffer buffer = _buffer;
+	MemoryAllocator::Allocation allocation = _allocation;
+
+	_deletion_queue->Push([=]() mutable
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator->Free(allocation);
+	});
 }
 
 
-void DataBuffer::Update( Renderer * renderer, void * data )
+// writes size bytes of data at offset, VK_WHOLE_SIZE writes the rest of the buffer.
+void DataBuffer::Update( const void * data, VkDeviceSize offset, VkDeviceSize size )
 {
-	ErrorCheck(vkMapMemory(renderer->GetDevice(), *&_memory, _offset, _buffer_size, 0, &_mapped), "Unable to map GPU memory.");
-	memcpy(_mapped, data, _buffer_size);
-	vkUnmapMemory(renderer->GetDevice(), _memory);
+	if (size == VK_WHOLE_SIZE)
+		size = _buffer_size - offset;
+
+	memcpy(static_cast<char*>(_allocation.mapped) + _offset + offset, data, (size_t)size);
+
+	// nothing to do for coherent memory.
+	_allocator->Flush(_allocation, _offset + offset, size);
 }
 
 
+VkBuffer DataBuffer::GetBuffer()
+{
+	return _buffer;
+}
+
 VkDescriptorSet DataBuffer::GetDescriptorSet()
 {
 	return _descriptor;
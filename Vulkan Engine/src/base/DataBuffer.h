@@ -3,28 +3,32 @@
 #include "../Platform.h"
 #include "../Shared.h"
 #include "../Renderer.h"
+#include "MemoryAllocator.h"
 #include "helpers\Structs.h"
 #include "glm\glm.hpp"
 
 class DataBuffer
 {
 	private:
-		uint32_t                            _buffer_size;
+		VkDevice                            _device;
+		MemoryAllocator			*			_allocator;
+		DeletionQueue			*			_deletion_queue;
+		VkDeviceSize                        _buffer_size;
 		VkDeviceSize                        _offset;
 
 		VkBuffer							_buffer;
-		VkDeviceMemory						_memory;
+		MemoryAllocator::Allocation			_allocation;
 		VkDescriptorBufferInfo				_descriptor_info;
 		VkDescriptorSet                     _descriptor;
 		VkWriteDescriptorSet                _write_descriptor;
-		void				*				_mapped;
 		VkMemoryRequirements				_memory_requirements;
 	public:
 		enum DataBufferType	{ UNIFORM, SBO };
 
-		DataBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, uint32_t size, VkDeviceSize offset = 0);
+		DataBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, VkDeviceSize size, VkDeviceSize offset = 0);
 		~DataBuffer();
-		void								Update( Renderer * renderer, void * data );
+		void								Update( const void * data, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+		VkBuffer                            GetBuffer();
 		VkDescriptorSet                     GetDescriptorSet();
 		VkDescriptorBufferInfo        *     GetDescriptorInfo();
 };
\ No newline at end of file
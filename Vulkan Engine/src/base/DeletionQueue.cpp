@@ -0,0 +1,57 @@
+#include "DeletionQueue.h"
+
+DeletionQueue::DeletionQueue( uint32_t frame_count )
+{
+	_buckets.resize( frame_count );
+}
+
+// whatever is left goes with the device, the caller waited for it to be idle.
+DeletionQueue::~DeletionQueue()
+{
+	Flush();
+}
+
+
+// queued behind the frame being recorded, which may be submitted already or not yet.
+void DeletionQueue::Push( std::function<void()> deleter )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	_buckets[_frame].push_back( deleter );
+}
+
+// the fence of frame is signaled, what was queued the last time it was recorded is no longer used by any frame.
+void DeletionQueue::Collect( uint32_t frame )
+{
+	std::vector<std::function<void()>> deleters;
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_frame = frame % _buckets.size();
+		deleters.swap( _buckets[_frame] );
+	}
+
+	// deleters may queue more, they land in the bucket of this frame.
+	for ( auto & deleter : deleters )
+		deleter();
+}
+
+// everything at once, only while the device is idle. repeated until deleters queue nothing more.
+void DeletionQueue::Flush()
+{
+	bool pending = true;
+	while ( pending )
+	{
+		pending = false;
+		for ( size_t i = 0; i < _buckets.size(); i++ )
+		{
+			std::vector<std::function<void()>> deleters;
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				deleters.swap( _buckets[i] );
+			}
+
+			pending |= !deleters.empty();
+			for ( auto & deleter : deleters )
+				deleter();
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <mutex>
+#include <functional>
+#include <vector>
+
+#include "../Platform.h"
+
+// Vulkan objects handed over here are destroyed once the frames that may still use them have retired.
+// One bucket per frame in flight, a bucket runs when its frame slot comes around again behind its fence.
+class DeletionQueue
+{
+	private:
+		std::mutex									_mutex;
+		std::vector<std::vector<std::function<void()>>>	_buckets;
+		uint32_t									_frame					= 0;
+
+	public:
+		DeletionQueue( uint32_t frame_count );
+		~DeletionQueue();
+
+		void										Push( std::function<void()> deleter );
+		void										Collect( uint32_t frame );
+		void										Flush();
+};
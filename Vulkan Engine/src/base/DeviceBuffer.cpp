@@ -0,0 +1,115 @@
+#include "DeviceBuffer.h"
+
+DeviceBuffer::DeviceBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, uint32_t buffer_size, MemoryAllocator::Category category )
+{
+	_renderer    = renderer;
+	_buffer_size = buffer_size;
+
+	// written on the transfer queue, read on the compute queue. concurrent spares the ownership transfer.
+	uint32_t families[] = { renderer->GetTransferFamilyIndex(), renderer->GetComputeFamilyIndex() };
+
+	// create buffer
+	VkBufferCreateInfo		buffer_create_info = Structs::BufferCreateInfo(usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _buffer_size);
+	if (families[0] != families[1])
+	{
+		buffer_create_info.sharingMode				= VK_SHARING_MODE_CONCURRENT;
+		buffer_create_info.queueFamilyIndexCount	= 2;
+		buffer_create_info.pQueueFamilyIndices		= families;
+	}
+	ErrorCheck( vkCreateBuffer(renderer->GetDevice(), &buffer_create_info, nullptr, &_buffer), "Unable to create device local buffer.");
+
+	// get memory requirements
+	vkGetBufferMemoryRequirements(renderer->GetDevice(), _buffer, &_memory_requirements);
+
+	// allocate memory, any type the buffer takes when there is no device local one.
+	VkBool32 found = false;
+	uint32_t memory_type = renderer->GetGPUMemoryType(_memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &found);
+	if (!found)
+		memory_type = renderer->GetGPUMemoryType(_memory_requirements.memoryTypeBits, 0);
+	_allocation = renderer->GetAllocator()->Allocate(_memory_requirements, memory_type, MemoryAllocator::LINEAR, category);
+
+	// bind memory
+	ErrorCheck( vkBindBufferMemory(renderer->GetDevice(), _buffer, _allocation.memory, _allocation.offset), "Unable to bind device local memory." );
+
+	// upload
+	if (data != nullptr)
+		Update(data);
+
+	// create descriptor set
+	_descriptor_info = Structs::DescriptorBufferInfo(_buffer, _buffer_size);
+}
+
+// frames in flight may still read the buffer, it goes once they retired.
+DeviceBuffer::~DeviceBuffer()
+{
+	VkDevice device = _renderer->GetDevice();
+	MemoryAllocator * allocator = _renderer->GetAllocator();
+	VkBuffer buffer = _buffer;
+	MemoryAllocator::Allocation allocation = _allocation;
+
+	_renderer->GetDeletionQueue()->Push([=]() mutable
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator->Free(allocation);
+	});
+}
+
+
+// copies size bytes of data to offset through a staging buffer, waits for the copy.
+// the caller makes sure the gpu does not read the range meanwhile.
+void DeviceBuffer::Update( const void * data, VkDeviceSize offset, VkDeviceSize size )
+{
+	if (size == VK_WHOLE_SIZE)
+		size = _buffer_size - offset;
+
+	VkDevice device = _renderer->GetDevice();
+	DataBuffer staging(_renderer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, const_cast<void*>(data), (uint32_t)size);
+
+	// transient, uploads happen when the scene changes, not every frame.
+	VkCommandPool command_pool;
+	VkCommandPoolCreateInfo pool_create_info = Structs::CommandPoolCreateInfo(_renderer->GetTransferFamilyIndex());
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	ErrorCheck(vkCreateCommandPool(device, &pool_create_info, nullptr, &command_pool), "Unable to create upload command pool.");
+
+	VkCommandBuffer command_buffer;
+	VkCommandBufferAllocateInfo allocate_info = Structs::CommandBufferAllocateInfo(command_pool, 1);
+	ErrorCheck(vkAllocateCommandBuffers(device, &allocate_info, &command_buffer), "Unable to allocate upload command buffer.");
+
+	VkCommandBufferBeginInfo begin_info = Structs::CommandBufferBeginInfo();
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	VkBufferCopy region = {};
+	region.dstOffset	= offset;
+	region.size			= size;
+	vkCmdCopyBuffer(command_buffer, staging.GetBuffer(), _buffer, 1, &region);
+
+	ErrorCheck(vkEndCommandBuffer(command_buffer), "Unable to record upload command buffer.");
+
+	// the fence makes the copy visible to later submits on any queue.
+	VkFence fence;
+	VkFenceCreateInfo fence_create_info = Structs::FenceCreateInfo();
+	fence_create_info.flags = 0;
+	ErrorCheck(vkCreateFence(device, &fence_create_info, nullptr, &fence), "Unable to create upload fence.");
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount	= 1;
+	submit_info.pCommandBuffers		= &command_buffer;
+	ErrorCheck(vkQueueSubmit(_renderer->GetTransferQueue(), 1, &submit_info, fence), "Unable to submit upload.");
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+}
+
+
+VkBuffer DeviceBuffer::GetBuffer()
+{
+	return _buffer;
+}
+
+VkDescriptorBufferInfo * DeviceBuffer::GetDescriptorInfo()
+{
+	return &_descriptor_info;
+}
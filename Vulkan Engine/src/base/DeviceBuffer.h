@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../Platform.h"
+#include "../Shared.h"
+#include "../Renderer.h"
+#include "DataBuffer.h"
+#include "MemoryAllocator.h"
+#include "helpers\Structs.h"
+
+// device local buffer, filled through a staging DataBuffer copied on the transfer queue.
+// for data the gpu reads much more often than the cpu writes it, per frame data stays in DataBuffer.
+class DeviceBuffer
+{
+	private:
+		Renderer				*			_renderer;
+		uint32_t                            _buffer_size;
+
+		VkBuffer							_buffer;
+		MemoryAllocator::Allocation			_allocation;
+		VkDescriptorBufferInfo				_descriptor_info;
+		VkMemoryRequirements				_memory_requirements;
+	public:
+		DeviceBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, void * data, uint32_t size, MemoryAllocator::Category category = MemoryAllocator::DEVICE_BUFFERS );
+		~DeviceBuffer();
+		void								Update( const void * data, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+		VkBuffer                            GetBuffer();
+		VkDescriptorBufferInfo        *     GetDescriptorInfo();
+};
@@ -0,0 +1,363 @@
+#include "MemoryAllocator.h"
+
+#include <iomanip>
+#include <iterator>
+
+static const char * category_names[MemoryAllocator::CATEGORY_COUNT] = { "buffers", "device buffers", "textures", "staging", "swapchain", "acceleration structures" };
+
+// flushed and invalidated ranges have to start and end on atom boundaries, or end with the memory.
+static VkMappedMemoryRange AtomRange( const MemoryAllocator::Allocation & allocation, VkDeviceSize offset, VkDeviceSize size, VkDeviceSize atom_size, VkDeviceSize memory_size )
+{
+	if (size == VK_WHOLE_SIZE)
+		size = allocation.size - offset;
+
+	VkDeviceSize begin	= (allocation.offset + offset) / atom_size * atom_size;
+	VkDeviceSize end	= (allocation.offset + offset + size + atom_size - 1) / atom_size * atom_size;
+
+	VkMappedMemoryRange range = {};
+	range.sType		= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory	= allocation.memory;
+	range.offset	= begin;
+	range.size		= end < memory_size ? end - begin : VK_WHOLE_SIZE;
+	return range;
+}
+
+
+
+MemoryAllocator::MemoryAllocator( VkDevice device, VkPhysicalDevice gpu )
+{
+	_device = device;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu, &properties);
+	vkGetPhysicalDeviceMemoryProperties(gpu, &_memory_properties);
+
+	_atom_size				= properties.limits.nonCoherentAtomSize;
+	_max_allocation_count	= properties.limits.maxMemoryAllocationCount;
+
+	// without VK_EXT_memory_budget the rest of the system and other processes are guessed at a fifth of every heap.
+	for (uint32_t i = 0; i < _memory_properties.memoryHeapCount; i++)
+		_heap_budget[i] = _memory_properties.memoryHeaps[i].size / 5 * 4;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (Block * block : _blocks)
+		_DestroyBlock(block);
+	_blocks.clear();
+}
+
+
+// memory_type comes from Renderer::GetGPUMemoryType. host visible memory comes back mapped.
+MemoryAllocator::Allocation MemoryAllocator::Allocate( VkMemoryRequirements requirements, uint32_t memory_type, Resource resource, Category category )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	VkMemoryPropertyFlags flags = _memory_properties.memoryTypes[memory_type].propertyFlags;
+	bool host_visible	= (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	bool coherent		= (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	// non coherent allocations own whole atoms, flushing one never touches a neighbour.
+	VkDeviceSize alignment	= requirements.alignment;
+	VkDeviceSize size		= requirements.size;
+	if (host_visible && !coherent)
+	{
+		alignment	= alignment > _atom_size ? alignment : _atom_size;
+		size		= (size + _atom_size - 1) / _atom_size * _atom_size;
+	}
+
+	// small heaps get smaller blocks, so one block does not take all of it.
+	uint32_t     heap		= _memory_properties.memoryTypes[memory_type].heapIndex;
+	VkDeviceSize heap_size	= _memory_properties.memoryHeaps[heap].size;
+	VkDeviceSize block_size	= heap_size / 8 < _block_size ? heap_size / 8 : _block_size;
+
+	VkDeviceSize budget = _heap_budget[heap];
+	if (_heap_allocated[heap] + size > budget)
+		std::cout << "GPU memory heap " << heap << " over budget, " << (_heap_allocated[heap] + size) / 1048576 << " of " << budget / 1048576 << " MB for " << category_names[category] << "." << std::endl;
+
+	Block		* block		= nullptr;
+	VkDeviceSize  offset	= 0;
+
+	// big resources would waste most of a block, they get memory of their own.
+	if (size > block_size / 2)
+	{
+		block = _CreateBlock(memory_type, resource, size, true);
+		_Take(block, size, alignment, &offset);
+	}
+	else
+	{
+		for (Block * candidate : _blocks)
+		{
+			if (candidate->type == memory_type && candidate->resource == resource && !candidate->dedicated && _Take(candidate, size, alignment, &offset))
+			{
+				block = candidate;
+				break;
+			}
+		}
+
+		// close to the budget, a new block only holds this request instead of a whole block's worth.
+		if (block == nullptr)
+		{
+			VkDeviceSize new_block_size = _heap_allocated[heap] + block_size > budget ? size : block_size;
+			block = _CreateBlock(memory_type, resource, new_block_size, false);
+			_Take(block, size, alignment, &offset);
+		}
+	}
+
+	block->allocation_count++;
+	_category_usage[heap][category] += size;
+
+	Allocation allocation;
+	allocation.memory	= block->memory;
+	allocation.offset	= offset;
+	allocation.size		= size;
+	allocation.mapped	= block->mapped != nullptr ? static_cast<char*>(block->mapped) + offset : nullptr;
+	allocation.type		= memory_type;
+	allocation.category	= category;
+	allocation.coherent	= coherent;
+	allocation.block	= block;
+	return allocation;
+}
+
+// returns the range to its block. dedicated blocks go back to the driver, shared ones are kept for reuse.
+void MemoryAllocator::Free( Allocation & allocation )
+{
+	if (allocation.block == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Block * block = static_cast<Block*>(allocation.block);
+	_Release(block, allocation.offset, allocation.size);
+	_category_usage[_memory_properties.memoryTypes[allocation.type].heapIndex][allocation.category] -= allocation.size;
+
+	if (--block->allocation_count == 0 && block->dedicated)
+	{
+		for (size_t i = 0; i < _blocks.size(); i++)
+		{
+			if (_blocks[i] == block)
+			{
+				_blocks.erase(_blocks.begin() + i);
+				break;
+			}
+		}
+		_DestroyBlock(block);
+	}
+
+	allocation = Allocation();
+}
+
+// makes cpu writes to non coherent memory visible to the gpu.
+void MemoryAllocator::Flush( const Allocation & allocation, VkDeviceSize offset, VkDeviceSize size )
+{
+	if (allocation.coherent || allocation.block == nullptr)
+		return;
+
+	VkMappedMemoryRange range = AtomRange(allocation, offset, size, _atom_size, static_cast<Block*>(allocation.block)->size);
+	vkFlushMappedMemoryRanges(_device, 1, &range);
+}
+
+// makes gpu writes to non coherent memory visible to the cpu.
+void MemoryAllocator::Invalidate( const Allocation & allocation, VkDeviceSize offset, VkDeviceSize size )
+{
+	if (allocation.coherent || allocation.block == nullptr)
+		return;
+
+	VkMappedMemoryRange range = AtomRange(allocation, offset, size, _atom_size, static_cast<Block*>(allocation.block)->size);
+	vkInvalidateMappedMemoryRanges(_device, 1, &range);
+}
+
+
+void MemoryAllocator::Track( Category category, uint32_t memory_type, VkDeviceSize size )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	uint32_t heap = _memory_properties.memoryTypes[memory_type].heapIndex;
+	_category_usage[heap][category]	+= size;
+	_heap_allocated[heap]			+= size;
+}
+
+void MemoryAllocator::Untrack( Category category, uint32_t memory_type, VkDeviceSize size )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	uint32_t heap = _memory_properties.memoryTypes[memory_type].heapIndex;
+	_category_usage[heap][category]	-= size;
+	_heap_allocated[heap]			-= size;
+}
+
+// the renderer keeps budgets current from VK_EXT_memory_budget, minus what other processes use.
+void MemoryAllocator::SetBudget( uint32_t heap, VkDeviceSize budget )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_heap_budget[heap] = budget;
+}
+
+uint32_t MemoryAllocator::GetHeapCount()
+{
+	return _memory_properties.memoryHeapCount;
+}
+
+VkMemoryHeap MemoryAllocator::GetHeap( uint32_t heap )
+{
+	return _memory_properties.memoryHeaps[heap];
+}
+
+const char * MemoryAllocator::GetCategoryName( Category category )
+{
+	return category_names[category];
+}
+
+
+MemoryAllocator::Statistics MemoryAllocator::GetStatistics( uint32_t memory_type )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Statistics statistics;
+	for (Block * block : _blocks)
+	{
+		if (block->type != memory_type)
+			continue;
+
+		VkDeviceSize unused = 0;
+		for (auto & range : block->free_ranges)
+			unused += range.second;
+
+		statistics.block_count++;
+		statistics.allocation_count	+= block->allocation_count;
+		statistics.allocated		+= block->size;
+		statistics.used				+= block->size - unused;
+	}
+	return statistics;
+}
+
+MemoryAllocator::HeapStatistics MemoryAllocator::GetHeapStatistics( uint32_t heap )
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	HeapStatistics statistics;
+	statistics.allocated	= _heap_allocated[heap];
+	statistics.budget		= _heap_budget[heap];
+	for (uint32_t i = 0; i < CATEGORY_COUNT; i++)
+	{
+		statistics.categories[i]	= _category_usage[heap][i];
+		statistics.used			   += _category_usage[heap][i];
+	}
+	return statistics;
+}
+
+void MemoryAllocator::PrintStatistics()
+{
+	uint32_t block_count = 0;
+	for (uint32_t i = 0; i < _memory_properties.memoryTypeCount; i++)
+	{
+		Statistics statistics = GetStatistics(i);
+		if (statistics.block_count == 0)
+			continue;
+
+		VkMemoryPropertyFlags flags = _memory_properties.memoryTypes[i].propertyFlags;
+		std::cout << "memory type " << i
+			<< ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? " device local" : "")
+			<< ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? " host visible" : "")
+			<< ": " << statistics.allocation_count << " allocations in " << statistics.block_count << " blocks, "
+			<< std::fixed << std::setprecision(1) << statistics.used / 1048576.0 << " of " << statistics.allocated / 1048576.0 << " MB used" << std::endl;
+
+		block_count += statistics.block_count;
+	}
+
+	std::cout << block_count << " of " << _max_allocation_count << " device allocations" << std::endl;
+}
+
+
+MemoryAllocator::Block * MemoryAllocator::_CreateBlock( uint32_t type, Resource resource, VkDeviceSize size, bool dedicated )
+{
+	Block * block		= new Block();
+	block->size			= size;
+	block->type			= type;
+	block->resource		= resource;
+	block->dedicated	= dedicated;
+	block->free_ranges[0] = size;
+	_heap_allocated[_memory_properties.memoryTypes[type].heapIndex] += size;
+
+	VkMemoryAllocateInfo memory_allocation_info = {};
+	memory_allocation_info.sType			= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memory_allocation_info.allocationSize	= size;
+	memory_allocation_info.memoryTypeIndex	= type;
+	ErrorCheck(vkAllocateMemory(_device, &memory_allocation_info, nullptr, &block->memory), "Unable to allocate GPU memory block.");
+
+	// host visible blocks stay mapped for their lifetime, every allocation gets its pointer from here.
+	if (_memory_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		ErrorCheck(vkMapMemory(_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped), "Unable to map GPU memory block.");
+
+	_blocks.push_back(block);
+	return block;
+}
+
+void MemoryAllocator::_DestroyBlock( Block * block )
+{
+	_heap_allocated[_memory_properties.memoryTypes[block->type].heapIndex] -= block->size;
+
+	if (block->mapped != nullptr)
+		vkUnmapMemory(_device, block->memory);
+	vkFreeMemory(_device, block->memory, nullptr);
+	delete block;
+}
+
+// best fit, the smallest free range the aligned size fits in.
+bool MemoryAllocator::_Take( Block * block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize * offset )
+{
+	auto best			= block->free_ranges.end();
+	VkDeviceSize start	= 0;
+
+	for (auto range = block->free_ranges.begin(); range != block->free_ranges.end(); ++range)
+	{
+		VkDeviceSize aligned = (range->first + alignment - 1) / alignment * alignment;
+		if (aligned + size > range->first + range->second)
+			continue;
+
+		if (best == block->free_ranges.end() || range->second < best->second)
+		{
+			best	= range;
+			start	= aligned;
+		}
+	}
+
+	if (best == block->free_ranges.end())
+		return false;
+
+	// what is left before and after the allocation stays free.
+	VkDeviceSize range_offset	= best->first;
+	VkDeviceSize range_end		= best->first + best->second;
+	block->free_ranges.erase(best);
+
+	if (start > range_offset)
+		block->free_ranges[range_offset] = start - range_offset;
+	if (start + size < range_end)
+		block->free_ranges[start + size] = range_end - (start + size);
+
+	*offset = start;
+	return true;
+}
+
+// merges the range with the free neighbours it touches.
+void MemoryAllocator::_Release( Block * block, VkDeviceSize offset, VkDeviceSize size )
+{
+	auto next = block->free_ranges.lower_bound(offset);
+	if (next != block->free_ranges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = block->free_ranges.erase(next);
+	}
+
+	if (next != block->free_ranges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+
+	block->free_ranges[offset] = size;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include "../Platform.h"
+#include "../Shared.h"
+
+// Sub-allocates buffers and images from large blocks of device memory, one set of blocks per memory type.
+// Keeps the engine far below maxMemoryAllocationCount, however many buffers and textures a scene has.
+// Every allocation is tagged with what it is for, so the footprint of a render is known per heap and category.
+class MemoryAllocator
+{
+	public:
+		// buffers and linear images never share a block with optimal images, bufferImageGranularity never applies.
+		enum Resource { LINEAR, OPTIMAL, RESOURCE_COUNT };
+
+		enum Category
+		{
+			BUFFERS,						// host visible DataBuffers
+			DEVICE_BUFFERS,					// scene and queues in device local DeviceBuffers
+			TEXTURES,
+			STAGING,						// uploads and readbacks
+			SWAPCHAIN,						// owned by the driver, tracked from the swapchain extent
+			ACCELERATION_STRUCTURES,
+			CATEGORY_COUNT
+		};
+
+		struct Allocation
+		{
+			VkDeviceMemory					memory					= VK_NULL_HANDLE;
+			VkDeviceSize					offset					= 0;
+			VkDeviceSize					size					= 0;
+			void				*			mapped					= nullptr;		// already at offset, null unless host visible
+			uint32_t						type					= 0;
+			Category						category				= BUFFERS;
+			bool							coherent				= true;
+			void				*			block					= nullptr;
+		};
+
+		struct Statistics
+		{
+			uint32_t						block_count				= 0;
+			uint32_t						allocation_count		= 0;
+			VkDeviceSize					allocated				= 0;			// bytes taken from the driver
+			VkDeviceSize					used					= 0;			// bytes handed out
+		};
+
+		struct HeapStatistics
+		{
+			VkDeviceSize					allocated				= 0;			// blocks, plus tracked memory of the driver
+			VkDeviceSize					used					= 0;
+			VkDeviceSize					budget					= 0;
+			VkDeviceSize					categories[CATEGORY_COUNT]	= {};
+		};
+
+	private:
+		struct Block
+		{
+			VkDeviceMemory					memory					= VK_NULL_HANDLE;
+			VkDeviceSize					size					= 0;
+			void				*			mapped					= nullptr;
+			uint32_t						type					= 0;
+			Resource						resource				= LINEAR;
+			bool							dedicated				= false;
+			uint32_t						allocation_count		= 0;
+			std::map<VkDeviceSize, VkDeviceSize>		free_ranges;						// offset -> size
+		};
+
+		VkDevice							_device					= VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties	_memory_properties		= {};
+		VkDeviceSize						_atom_size				= 1;
+		VkDeviceSize						_block_size				= 64 * 1024 * 1024;
+		uint32_t							_max_allocation_count	= 0;
+
+		std::vector<Block*>					_blocks;
+		std::mutex							_mutex;
+
+		// bytes per heap and category, and what each heap may take before the driver starts paging.
+		VkDeviceSize						_category_usage[VK_MAX_MEMORY_HEAPS][CATEGORY_COUNT]	= {};
+		VkDeviceSize						_heap_allocated[VK_MAX_MEMORY_HEAPS]					= {};
+		VkDeviceSize						_heap_budget[VK_MAX_MEMORY_HEAPS]						= {};
+
+		Block				*				_CreateBlock( uint32_t type, Resource resource, VkDeviceSize size, bool dedicated );
+		void								_DestroyBlock( Block * block );
+		bool								_Take( Block * block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize * offset );
+		void								_Release( Block * block, VkDeviceSize offset, VkDeviceSize size );
+
+	public:
+		MemoryAllocator( VkDevice device, VkPhysicalDevice gpu );
+		~MemoryAllocator();
+
+		Allocation							Allocate( VkMemoryRequirements requirements, uint32_t memory_type, Resource resource, Category category );
+		void								Free( Allocation & allocation );
+		void								Flush( const Allocation & allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+		void								Invalidate( const Allocation & allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+
+		// memory the driver allocates on its own, like swapchain images, counted against the heap of memory_type.
+		void								Track( Category category, uint32_t memory_type, VkDeviceSize size );
+		void								Untrack( Category category, uint32_t memory_type, VkDeviceSize size );
+
+		void								SetBudget( uint32_t heap, VkDeviceSize budget );
+		uint32_t							GetHeapCount();
+		VkMemoryHeap						GetHeap( uint32_t heap );
+
+		Statistics							GetStatistics( uint32_t memory_type );
+		HeapStatistics						GetHeapStatistics( uint32_t heap );
+		void								PrintStatistics();
+
+		static const char		*			GetCategoryName( Category category );
+};
@@ -0,0 +1,60 @@
+#include "RingBuffer.h"
+
+// range is what one dynamic descriptor sees from its offset on, the largest thing pushed at once.
+RingBuffer::RingBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, uint32_t region_size, uint32_t region_count, uint32_t range )
+{
+	// dynamic offsets have to be multiples of the alignment of every descriptor type the buffer is bound as.
+	VkPhysicalDeviceLimits limits = renderer->GetGPUProperties().limits;
+	VkDeviceSize alignment = 1;
+	if (usage_flags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		alignment = limits.minUniformBufferOffsetAlignment > alignment ? limits.minUniformBufferOffsetAlignment : alignment;
+	if (usage_flags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		alignment = limits.minStorageBufferOffsetAlignment > alignment ? limits.minStorageBufferOffsetAlignment : alignment;
+
+	_alignment		= (uint32_t)alignment;
+	_region_size	= (region_size + _alignment - 1) / _alignment * _alignment;
+	_region_count	= region_count;
+	_region			= 0;
+	_head			= 0;
+
+	_buffer			= new DataBuffer(renderer, usage_flags, nullptr, _region_size * _region_count);
+
+	VkBuffer buffer = _buffer->GetBuffer();
+	_descriptor_info = Structs::DescriptorBufferInfo(buffer, range);
+}
+
+RingBuffer::~RingBuffer()
+{
+	delete _buffer;
+}
+
+
+// starts filling the region of a frame, the caller made sure the gpu is done with it.
+void RingBuffer::Begin( uint32_t region )
+{
+	_region	= region % _region_count;
+	_head	= 0;
+}
+
+// copies data behind what the frame pushed so far, returns the dynamic offset of the copy.
+uint32_t RingBuffer::Push( const void * data, uint32_t size )
+{
+	assert(_head + size <= _region_size && "Ring buffer region is full.");
+
+	uint32_t offset = _region * _region_size + _head;
+	_buffer->Update(data, offset, size);
+
+	_head += (size + _alignment - 1) / _alignment * _alignment;
+	return offset;
+}
+
+
+VkBuffer RingBuffer::GetBuffer()
+{
+	return _buffer->GetBuffer();
+}
+
+VkDescriptorBufferInfo * RingBuffer::GetDescriptorInfo()
+{
+	return &_descriptor_info;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../Platform.h"
+#include "../Shared.h"
+#include "../Renderer.h"
+#include "DataBuffer.h"
+
+// Host visible buffer carved into one region per frame in flight, filled front to back every frame.
+// Data is bound with dynamic descriptor offsets, a frame gets fresh memory without allocations or descriptor updates.
+class RingBuffer
+{
+	private:
+		DataBuffer				*			_buffer;
+		VkDescriptorBufferInfo				_descriptor_info;
+
+		uint32_t							_alignment;
+		uint32_t							_region_size;
+		uint32_t							_region_count;
+		uint32_t							_region;
+		uint32_t							_head;
+
+	public:
+		RingBuffer( Renderer * renderer, VkBufferUsageFlags usage_flags, uint32_t region_size, uint32_t region_count, uint32_t range );
+		~RingBuffer();
+
+		void								Begin( uint32_t region );
+		uint32_t							Push( const void * data, uint32_t size );
+
+		VkBuffer							GetBuffer();
+		VkDescriptorBufferInfo		*		GetDescriptorInfo();
+};
@@ -1,6 +1,6 @@
 #include "Shader.h"
 
-std::map<const char *, VkShaderModule> Shader::_shader_modules;
+std::map<std::string, VkShaderModule> Shader::_shader_modules;
 
 
 Shader::Shader()
@@ -69,3 +69,11 @@ VkPipelineShaderStageCreateInfo Shader::LoadShaderStage(const char *fileName, Vk
 	// construct pipeline shater stage info.
 	return Structs::PipelineShaderStageCreateInfo("main", stage, shader_module);
 }
+
+// pipelines keep what they need, modules can go once they are created. the next load reads the file again.
+void Shader::DestroyShaderModules(VkDevice device)
+{
+	for (auto & shader_module : _shader_modules)
+		vkDestroyShaderModule(device, shader_module.second, nullptr);
+	_shader_modules.clear();
+}
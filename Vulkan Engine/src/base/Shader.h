@@ -8,6 +8,7 @@
 
 #include <vector>
 #include <map>
+#include <string>
 
 class Shader
 {
@@ -16,7 +17,8 @@ class Shader
 		~Shader();
 
 		static VkPipelineShaderStageCreateInfo LoadShaderStage(const char *fileName, VkDevice device, VkShaderStageFlagBits stage);
-		static std::map<const char *, VkShaderModule> _shader_modules;
+		static void DestroyShaderModules(VkDevice device);
+		static std::map<std::string, VkShaderModule> _shader_modules;
 	//	static std::vector<VkShaderModule> * _shader_mods = { nullptr };
 	private:
 		
@@ -0,0 +1,71 @@
+#include "Worker.h"
+
+Worker::Worker()
+{
+	_thread = std::thread( &Worker::_Run, this );
+}
+
+Worker::~Worker()
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_running = false;
+	}
+
+	_condition.notify_all();
+	_thread.join();
+}
+
+
+void Worker::Push( std::function<void()> job )
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_jobs.push_back( job );
+	}
+
+	_condition.notify_one();
+}
+
+void Worker::Wait()
+{
+	std::unique_lock<std::mutex> lock( _mutex );
+	_condition_idle.wait( lock, [this] { return _jobs.empty() && !_busy; } );
+}
+
+size_t Worker::Pending()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _jobs.size() + ( _busy ? 1 : 0 );
+}
+
+
+void Worker::_Run()
+{
+	while ( true )
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			_condition.wait( lock, [this] { return !_jobs.empty() || !_running; } );
+
+			// finish queued jobs before shutting down, so no file is left half written.
+			if ( _jobs.empty() && !_running )
+				return;
+
+			job		= _jobs.front();
+			_busy	= true;
+			_jobs.pop_front();
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_busy = false;
+		}
+
+		_condition_idle.notify_all();
+	}
+}
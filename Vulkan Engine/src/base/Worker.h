@@ -0,0 +1,31 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+// Single background thread executing queued jobs in order.
+// Used for anything the render loop must never wait on ( disk writes etc. ).
+class Worker
+{
+	private:
+		std::thread									_thread;
+		std::mutex									_mutex;
+		std::condition_variable						_condition;
+		std::condition_variable						_condition_idle;
+		std::deque<std::function<void()>>			_jobs;
+		bool										_busy					= false;
+		bool										_running				= true;
+
+		void										_Run();
+
+	public:
+		Worker();
+		~Worker();
+
+		void										Push( std::function<void()> job );
+		void										Wait();
+		size_t										Pending();
+};
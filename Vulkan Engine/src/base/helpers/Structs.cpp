@@ -12,7 +12,7 @@ VkDescriptorSetLayoutBinding Structs::DescriptorSetLayoutBinding(VkDescriptorTyp
 	return layout;
 }
 
-VkDescriptorSetLayoutCreateInfo & Structs::DescriptorSetLayoutCreateInfo(std::vector<VkDescriptorSetLayoutBinding> & bindings)
+VkDescriptorSetLayoutCreateInfo Structs::DescriptorSetLayoutCreateInfo(std::vector<VkDescriptorSetLayoutBinding> & bindings)
 {
 	VkDescriptorSetLayoutCreateInfo create_info = {};
 
@@ -33,7 +33,7 @@ VkDescriptorPoolSize Structs::DescriptorPoolSize(VkDescriptorType type, uint32_t
 	return descriptor_pool_size;
 }
 
-VkDescriptorPoolCreateInfo Structs::DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize> & pool_sizes)
+VkDescriptorPoolCreateInfo Structs::DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize> & pool_sizes, uint32_t max_sets)
 {
 	VkDescriptorPoolCreateInfo pool_info = {};
 
@@ -41,7 +41,7 @@ VkDescriptorPoolCreateInfo Structs::DescriptorPoolCreateInfo(std::vector<VkDescr
 	pool_info.pNext				= NULL;
 	pool_info.poolSizeCount		= (uint32_t)pool_sizes.size();
 	pool_info.pPoolSizes		= pool_sizes.data();
-	pool_info.maxSets			= 3;
+	pool_info.maxSets			= max_sets;
 
 	return pool_info;
 }
@@ -117,14 +117,27 @@ VkImageSubresourceRange	Structs::ImageSubresourceRange(VkImageAspectFlags aspect
 }
 
 
-VkPipelineLayoutCreateInfo Structs::PipelineLayoutCreateInfo(VkDescriptorSetLayout & descript_set_layout)
+VkPushConstantRange Structs::PushConstantRange(VkShaderStageFlags flags, uint32_t size, uint32_t offset)
+{
+	VkPushConstantRange range = {};
+
+	range.stageFlags	= flags;
+	range.offset		= offset;
+	range.size			= size;
+
+	return range;
+}
+
+VkPipelineLayoutCreateInfo Structs::PipelineLayoutCreateInfo(VkDescriptorSetLayout & descript_set_layout, VkPushConstantRange * push_constant_range)
 {
 	VkPipelineLayoutCreateInfo create_info = {};
 
-	create_info.sType			= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	create_info.pNext			= nullptr;
-	create_info.setLayoutCount	= 1;
-	create_info.pSetLayouts		= &descript_set_layout;
+	create_info.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	create_info.pNext					= nullptr;
+	create_info.setLayoutCount			= 1;
+	create_info.pSetLayouts				= &descript_set_layout;
+	create_info.pushConstantRangeCount	= push_constant_range != nullptr ? 1 : 0;
+	create_info.pPushConstantRanges		= push_constant_range;
 
 	return create_info;
 }
@@ -7,10 +7,10 @@ class Structs
 {
 	public:
 		static VkDescriptorSetLayoutBinding	 		DescriptorSetLayoutBinding(VkDescriptorType type, VkShaderStageFlags flags, uint32_t binding);
-		static VkDescriptorSetLayoutCreateInfo &	DescriptorSetLayoutCreateInfo(std::vector<VkDescriptorSetLayoutBinding> & bindings);
+		static VkDescriptorSetLayoutCreateInfo		DescriptorSetLayoutCreateInfo(std::vector<VkDescriptorSetLayoutBinding> & bindings);
 
 		static VkDescriptorPoolSize					DescriptorPoolSize(VkDescriptorType type, uint32_t descriptorCount);
-		static VkDescriptorPoolCreateInfo			DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize> & pool_sizes);
+		static VkDescriptorPoolCreateInfo			DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize> & pool_sizes, uint32_t max_sets = 3);
 
 		static VkWriteDescriptorSet					WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType type, uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
 		static VkWriteDescriptorSet					WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType type, uint32_t binding, VkDescriptorImageInfo* imageInfo);
@@ -19,7 +19,8 @@ class Structs
 		static VkDescriptorImageInfo				DescriptorImageInfo(VkImageView image, VkSampler sampler);
 		
 
-		static VkPipelineLayoutCreateInfo			PipelineLayoutCreateInfo(VkDescriptorSetLayout & descript_set_layout);
+		static VkPushConstantRange					PushConstantRange(VkShaderStageFlags flags, uint32_t size, uint32_t offset = 0);
+		static VkPipelineLayoutCreateInfo			PipelineLayoutCreateInfo(VkDescriptorSetLayout & descript_set_layout, VkPushConstantRange * push_constant_range = nullptr);
 		static VkPipelineCacheCreateInfo			PipelineCacheCreateInfo();
 		static VkComputePipelineCreateInfo			ComputePipelineCreateInfo(VkPipelineLayout pipeline_layout);
 